@@ -1,5 +1,25 @@
 @PACKAGE_INIT@
 
+include(CMakeFindDependencyMacro)
+find_dependency(Threads)
+
+# Libraries linked by the ITT and Tracy targets, including the static engines
+# (rt and dl are linked by name). INSTRMT_ENGINE is ignored by the static
+# engines, they are initialized without dlopen.
+if (@INSTRMT_BUILD_ITT_ENGINE@ AND NOT TARGET ittapi::ittnotify)
+  if (NOT "@ittapi_DIR@" STREQUAL "")
+    find_dependency(ittapi CONFIG HINTS "@ittapi_DIR@")
+  else()
+    set(VTUNE_ROOT "@VTUNE_ROOT@" CACHE PATH "Root directory of VTune's profiler")
+    include("${CMAKE_CURRENT_LIST_DIR}/instrmt-macros.cmake")
+    find_itt_module()
+  endif()
+endif()
+
+if (@INSTRMT_BUILD_TRACY_ENGINE@ AND NOT TARGET Tracy::TracyClient)
+  find_dependency(Tracy)
+endif()
+
 include("${CMAKE_CURRENT_LIST_DIR}/InstrmtTargets.cmake")
 
 check_required_components(Instrmt)
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""Reports the code size of the instrumentation, per 1000 sites.
+
+Usage: code-size.py SITES BASELINE [NAME=OBJECT...]
+
+Each object file instruments SITES sites (the same functions compiled with
+different wrappers). The sizes of its executable sections (code), of the part
+of the code moved out of the hot path by the compiler (cold, .text.unlikely
+and .text.*.cold sections) and of all its allocated sections (code, data and
+unwind tables) are compared to the ones of the BASELINE object, compiled
+without instrumentation. Functions are aligned, the code includes padding.
+"""
+
+import struct
+import sys
+
+SHF_ALLOC = 0x2
+SHF_EXECINSTR = 0x4
+
+
+def section_sizes(path):
+    """Returns the total size of the executable, cold and allocated sections of an ELF64 little-endian object."""
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    if data[:4] != b'\x7fELF' or data[4] != 2 or data[5] != 1:
+        sys.exit('{}: not an ELF64 little-endian object'.format(path))
+
+    shoff, = struct.unpack_from('<Q', data, 0x28)
+    shentsize, shnum, shstrndx = struct.unpack_from('<HHH', data, 0x3a)
+    _, _, _, _, names_offset, _ = struct.unpack_from('<IIQQQQ', data, shoff + shstrndx * shentsize)
+
+    text = cold = alloc = 0
+    for i in range(shnum):
+        name_offset, _, flags, _, _, size = struct.unpack_from('<IIQQQQ', data, shoff + i * shentsize)
+        name_end = data.index(b'\0', names_offset + name_offset)
+        name = data[names_offset + name_offset:name_end].decode()
+        if flags & SHF_EXECINSTR:
+            text += size
+            if name.startswith('.text.unlikely') or name.endswith('.cold'):
+                cold += size
+        if flags & SHF_ALLOC:
+            alloc += size
+    return text, cold, alloc
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit(__doc__.splitlines()[2])
+
+    sites = int(sys.argv[1])
+    base_text, base_cold, base_alloc = section_sizes(sys.argv[2])
+
+    rows = []
+    for arg in sys.argv[3:]:
+        name, _, path = arg.partition('=')
+        text, cold, alloc = section_sizes(path)
+        rows.append([name,
+                     '{:.0f}'.format((text - base_text) * 1000.0 / sites),
+                     '{:.0f}'.format((cold - base_cold) * 1000.0 / sites),
+                     '{:.0f}'.format((alloc - base_alloc) * 1000.0 / sites)])
+
+    header = ['wrapper', 'code/1000 sites', 'cold/1000 sites', 'total/1000 sites']
+    widths = [max(len(r[i]) for r in rows + [header]) for i in range(len(header))]
+    for r in [header] + rows:
+        print('  '.join(v.ljust(w) if i == 0 else v.rjust(w) for i, (v, w) in enumerate(zip(r, widths))))
+
+
+if __name__ == '__main__':
+    main()
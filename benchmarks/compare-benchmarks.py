@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""Compares two runs of the benchmarks and fails on performance regressions.
+
+Usage: compare-benchmarks.py [-t THRESHOLD] [-m METRIC] BASELINE CONTENDER
+
+BASELINE and CONTENDER are Google Benchmark JSON files (--benchmark_out), or
+directories of such files (run-benchmarks.py -o), in which case the files with
+the same name are compared.
+
+Run the benchmarks with --benchmark_repetitions=N (N >= 2) to get confidence
+intervals. For each benchmark, the difference of the means is reported with
+its 95% confidence interval (Welch's t-test). A benchmark regresses when the
+whole interval is above THRESHOLD percent of the baseline, or, without
+repetitions, when the difference itself is. The exit status is 1 when a
+benchmark regresses.
+"""
+
+import argparse
+import json
+import math
+import os
+import sys
+
+# Two-sided 95% quantiles of Student's t-distribution, by degrees of freedom.
+T_95 = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042]
+
+
+def t_95(df):
+    if df < 1:
+        return T_95[0]
+    if df > len(T_95):
+        return 1.960
+    return T_95[int(df) - 1]
+
+
+def load(path, metric):
+    """Returns the samples of each benchmark of a JSON file."""
+    with open(path) as f:
+        results = json.load(f)
+
+    samples = {}
+    for b in results['benchmarks']:
+        if b.get('run_type', 'iteration') != 'iteration' or b.get('error_occurred'):
+            continue
+        if metric not in b:
+            continue
+        value = b[metric]
+        if metric in ('real_time', 'cpu_time'):
+            value = to_seconds(value, b.get('time_unit', 'ns'))
+        samples.setdefault(b.get('run_name', b['name']), []).append(value)
+    return samples
+
+
+def to_seconds(value, unit):
+    return value * {'s': 1.0, 'ms': 1e-3, 'us': 1e-6, 'ns': 1e-9}[unit]
+
+
+def stats(samples):
+    n = len(samples)
+    mean = sum(samples) / n
+    var = sum((x - mean) ** 2 for x in samples) / (n - 1) if n > 1 else 0.0
+    return n, mean, var
+
+
+def compare(baseline, contender):
+    """Difference of the means, and half width of its 95% confidence interval (None without repetitions)."""
+    nb, mb, vb = stats(baseline)
+    nc, mc, vc = stats(contender)
+    delta = mc - mb
+    if nb < 2 or nc < 2:
+        return delta, None
+
+    sb, sc = vb / nb, vc / nc
+    se = math.sqrt(sb + sc)
+    if se == 0.0:
+        return delta, 0.0
+    df = (sb + sc) ** 2 / (sb ** 2 / (nb - 1) + sc ** 2 / (nc - 1))
+    return delta, t_95(df) * se
+
+
+def format_time(seconds):
+    for unit, scale in (('s', 1.0), ('ms', 1e-3), ('us', 1e-6)):
+        if abs(seconds) >= scale:
+            return '{:.3g} {}'.format(seconds / scale, unit)
+    return '{:.3g} ns'.format(seconds / 1e-9)
+
+
+# Metrics in seconds, the other counters are printed as is.
+TIME_METRICS = ('per_site', 'real_time', 'cpu_time')
+
+
+def format_value(value, metric):
+    return format_time(value) if metric in TIME_METRICS else '{:.4g}'.format(value)
+
+
+def pairs(baseline, contender):
+    if os.path.isdir(baseline) != os.path.isdir(contender):
+        sys.exit('Cannot compare a file with a directory')
+    if not os.path.isdir(baseline):
+        return [('', baseline, contender)]
+
+    files = sorted(f for f in os.listdir(baseline)
+                   if f.endswith('.json') and os.path.isfile(os.path.join(contender, f)))
+    if not files:
+        sys.exit('No common JSON file in {} and {}'.format(baseline, contender))
+    return [(f[:-len('.json')] + '/', os.path.join(baseline, f), os.path.join(contender, f)) for f in files]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('-t', '--threshold', type=float, default=5.0, help='tolerated slowdown, in percent (default: 5)')
+    parser.add_argument('-m', '--metric', default='per_site', help='value to compare: per_site, real_time, cpu_time or another counter (default: per_site, or real_time for the benchmarks without it)')
+    parser.add_argument('baseline')
+    parser.add_argument('contender')
+    options = parser.parse_args()
+
+    rows = []
+    regressions = 0
+    for prefix, baseline_path, contender_path in pairs(options.baseline, options.contender):
+        baseline = load(baseline_path, options.metric)
+        contender = load(contender_path, options.metric)
+        if options.metric == 'per_site':
+            for name, values in load(baseline_path, 'real_time').items():
+                baseline.setdefault(name, values)
+            for name, values in load(contender_path, 'real_time').items():
+                contender.setdefault(name, values)
+
+        for name in sorted(baseline.keys() & contender.keys()):
+            mean = sum(baseline[name]) / len(baseline[name])
+            delta, ci = compare(baseline[name], contender[name])
+            low = delta - ci if ci is not None else delta
+            limit = abs(mean) * options.threshold / 100.0
+            regressed = low > limit
+            regressions += regressed
+
+            relative = '{:+.1f}%'.format(100.0 * delta / mean) if mean else '-'
+            interval = '+/- {}'.format(format_value(ci, options.metric)) if ci is not None else '-'
+            rows.append([prefix + name, format_value(mean, options.metric), format_value(delta, options.metric), interval, relative,
+                         'REGRESSION' if regressed else ''])
+
+    if not rows:
+        sys.exit('No common benchmark to compare')
+
+    header = ['benchmark', 'baseline', 'delta', '95% CI', 'relative', '']
+    widths = [max(len(r[i]) for r in rows + [header]) for i in range(len(header))]
+    for r in [header] + rows:
+        print('  '.join(v.ljust(w) if i == 0 else v.rjust(w) for i, (v, w) in enumerate(zip(r, widths))).rstrip())
+
+    if regressions:
+        print('{} benchmark(s) regressed by more than {}%'.format(regressions, options.threshold), file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -1,44 +1,115 @@
 #!/bin/bash
+#
+# Generates the instrumented functions used by the benchmarks.
+#
+# Usage: generate-benchmarks.sh [-n SITES] [-d DEPTH] [-l LITERALS] [-m MESSAGES] [-u NAMES] [-c CHUNK] [-o DIR]
+#
+#   -n SITES     Number of region sites (default: 1000).
+#   -d DEPTH     Regions are nested in chains of DEPTH regions (default: 1).
+#   -l LITERALS  Number of literal message sites (default: 1000).
+#   -m MESSAGES  Number of dynamic message sites (default: 1000).
+#   -u NAMES     Use NAMES distinct names for regions and literal messages, instead
+#                of one name per site (default: 0, use the name of the function).
+#   -c CHUNK     Number of sites per source file (default: 1000).
+#   -o DIR       Output directory (default: current directory).
 
-function printf_n()
-{
-  local i
-  for i in $(seq 1 $1) ; do
-    printf "$2\n" $i
-  done
-}
+set -e
 
-{
-  printf_n 1000 "void f%d();"
-  printf_n 1000 "void lm%d();"
-  printf_n 1000 "void m%d();"
-} > instrmt-benchmarks-functions.hxx
+sites=1000
+depth=1
+literals=1000
+messages=1000
+names=0
+chunk=1000
+out=.
+
+while getopts "n:d:l:m:u:c:o:" opt; do
+  case $opt in
+    n) sites=$OPTARG ;;
+    d) depth=$OPTARG ;;
+    l) literals=$OPTARG ;;
+    m) messages=$OPTARG ;;
+    u) names=$OPTARG ;;
+    c) chunk=$OPTARG ;;
+    o) out=$OPTARG ;;
+    *) exit 1 ;;
+  esac
+done
+
+mkdir -p "$out"
+rm -f "$out"/instrmt-benchmarks-functions-*.cxx
+
+# Number of source files.
+max=$sites
+(( literals > max )) && max=$literals
+(( messages > max )) && max=$messages
+files=$(( (max + chunk - 1) / chunk ))
+(( files == 0 )) && files=1
 
 {
-  echo "#include <instrmt/instrmt.hxx>"
-  printf_n 1000 "void f%d() { INSTRMT_FUNCTION(); }"
-  printf_n 1000 "void lm%d() { INSTRMT_LITERAL_MESSAGE(__FUNCTION__); }"
-  printf_n 1000 "void m%d() { INSTRMT_MESSAGE(__FUNCTION__); }"
-} > instrmt-benchmarks-functions.cxx
+  echo "// Generated by generate-benchmarks.sh -n $sites -d $depth -l $literals -m $messages -u $names"
+  echo "constexpr int benchmark_sites = $sites;"
+  echo "constexpr int benchmark_depth = $depth;"
+  echo "constexpr int benchmark_literal_messages = $literals;"
+  echo "constexpr int benchmark_messages = $messages;"
+  echo
+  awk -v n="$sites" 'BEGIN { for (i = 1; i <= n; ++i) printf "void f%d();\n", i }'
+  awk -v n="$literals" 'BEGIN { for (i = 1; i <= n; ++i) printf "void lm%d();\n", i }'
+  awk -v n="$messages" 'BEGIN { for (i = 1; i <= n; ++i) printf "void m%d();\n", i }'
+} > "$out/instrmt-benchmarks-functions.hxx"
+
+for (( file = 1; file <= files; ++file )); do
+  first=$(( (file - 1) * chunk + 1 ))
+  last=$(( file * chunk ))
+  {
+    echo "#include <instrmt/instrmt.hxx>"
+    echo
+    echo "#include \"instrmt-benchmarks-functions.hxx\""
+    echo
+    awk -v first="$first" -v last="$last" -v n="$sites" -v depth="$depth" -v names="$names" 'BEGIN {
+      for (i = first; i <= last && i <= n; ++i) {
+        region = names > 0 ? sprintf("INSTRMT_REGION(\"region%d\")", (i - 1) % names + 1) : "INSTRMT_FUNCTION()"
+        # The first region of each chain is called by all_functions(), the others by their parent.
+        if ((i - 1) % depth < depth - 1 && i < n)
+          printf "void f%d() { %s; f%d(); }\n", i, region, i + 1
+        else
+          printf "void f%d() { %s; }\n", i, region
+      }
+    }'
+    awk -v first="$first" -v last="$last" -v n="$literals" -v names="$names" 'BEGIN {
+      for (i = first; i <= last && i <= n; ++i) {
+        if (names > 0)
+          printf "void lm%d() { INSTRMT_LITERAL_MESSAGE(\"message%d\"); }\n", i, (i - 1) % names + 1
+        else
+          printf "void lm%d() { INSTRMT_LITERAL_MESSAGE(__FUNCTION__); }\n", i
+      }
+    }'
+    awk -v first="$first" -v last="$last" -v n="$messages" 'BEGIN {
+      for (i = first; i <= last && i <= n; ++i)
+        printf "void m%d() { INSTRMT_MESSAGE(__FUNCTION__); }\n", i
+    }'
+  } > "$out/instrmt-benchmarks-functions-$file.cxx"
+done
 
 {
-  echo "void function1000();"
-  echo "void lmessage1000();"
-  echo "void message1000();"
-} > instrmt-benchmarks-functions2.hxx
+  echo "void all_functions();"
+  echo "void all_literal_messages();"
+  echo "void all_messages();"
+} > "$out/instrmt-benchmarks-functions2.hxx"
 
 {
-  echo "#include <instrmt-benchmarks-functions.hxx>"
+  echo "#include \"instrmt-benchmarks-functions.hxx\""
+  echo "#include \"instrmt-benchmarks-functions2.hxx\""
   echo
-  echo "void function1000() {"
-  printf_n 1000 "  f%d();"
+  echo "void all_functions() {"
+  awk -v n="$sites" -v depth="$depth" 'BEGIN { for (i = 1; i <= n; i += depth) printf "  f%d();\n", i }'
   echo "}"
-
-  echo "void lmessage1000() {"
-  printf_n 1000 "  lm%d();"
+  echo
+  echo "void all_literal_messages() {"
+  awk -v n="$literals" 'BEGIN { for (i = 1; i <= n; ++i) printf "  lm%d();\n", i }'
   echo "}"
-
-  echo "void message1000() {"
-  printf_n 1000 "  m%d();"
+  echo
+  echo "void all_messages() {"
+  awk -v n="$messages" 'BEGIN { for (i = 1; i <= n; ++i) printf "  m%d();\n", i }'
   echo "}"
-} > instrmt-benchmarks-functions2.cxx
+} > "$out/instrmt-benchmarks-functions2.cxx"
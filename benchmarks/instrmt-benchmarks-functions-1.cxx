@@ -1,4 +1,7 @@
 #include <instrmt/instrmt.hxx>
+
+#include "instrmt-benchmarks-functions.hxx"
+
 void f1() { INSTRMT_FUNCTION(); }
 void f2() { INSTRMT_FUNCTION(); }
 void f3() { INSTRMT_FUNCTION(); }
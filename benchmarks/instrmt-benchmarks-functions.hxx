@@ -1,3 +1,9 @@
+// Generated by generate-benchmarks.sh -n 1000 -d 1 -l 1000 -m 1000 -u 0
+constexpr int benchmark_sites = 1000;
+constexpr int benchmark_depth = 1;
+constexpr int benchmark_literal_messages = 1000;
+constexpr int benchmark_messages = 1000;
+
 void f1();
 void f2();
 void f3();
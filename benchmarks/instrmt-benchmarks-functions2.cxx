@@ -1,6 +1,7 @@
 #include "instrmt-benchmarks-functions.hxx"
+#include "instrmt-benchmarks-functions2.hxx"
 
-void function1000() {
+void all_functions() {
   f1();
   f2();
   f3();
@@ -1002,7 +1003,8 @@ void function1000() {
   f999();
   f1000();
 }
-void lmessage1000() {
+
+void all_literal_messages() {
   lm1();
   lm2();
   lm3();
@@ -2004,7 +2006,8 @@ void lmessage1000() {
   lm999();
   lm1000();
 }
-void message1000() {
+
+void all_messages() {
   m1();
   m2();
   m3();
@@ -1,3 +1,3 @@
-void function1000();
-void lmessage1000();
-void message1000();
+void all_functions();
+void all_literal_messages();
+void all_messages();
@@ -0,0 +1,74 @@
+#include <benchmark/benchmark.h>
+
+#include <instrmt/instrmt.hxx>
+
+#include <algorithm>
+#include <array>
+#include <thread>
+#include <utility>
+
+// Scalability of the instrumentation when several threads hit the same or
+// different sites at the same time. Times are wall-clock times per call.
+
+namespace {
+
+int max_threads() {
+  return static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+}
+
+constexpr std::size_t disjoint_sites = 64;
+
+// Each instantiation is a distinct site.
+template<std::size_t I>
+void disjoint_region() {
+  INSTRMT_REGION("disjoint");
+  benchmark::ClobberMemory();
+}
+
+typedef void (*Function)();
+
+template<std::size_t... I>
+constexpr std::array<Function, sizeof...(I)> make_disjoint_regions(std::index_sequence<I...>) {
+  return {{&disjoint_region<I>...}};
+}
+
+const std::array<Function, disjoint_sites> disjoint_regions = make_disjoint_regions(std::make_index_sequence<disjoint_sites>());
+
+} // anonymous namespace
+
+void bm_mt_same_region(benchmark::State& state) {
+  for (auto _ : state) {
+    INSTRMT_REGION("shared");
+    benchmark::ClobberMemory();
+  }
+}
+
+BENCHMARK(bm_mt_same_region)->ThreadRange(1, max_threads())->UseRealTime();
+
+
+void bm_mt_disjoint_regions(benchmark::State& state) {
+  const Function region = disjoint_regions[static_cast<std::size_t>(state.thread_index()) % disjoint_sites];
+  for (auto _ : state) {
+    region();
+  }
+}
+
+BENCHMARK(bm_mt_disjoint_regions)->ThreadRange(1, max_threads())->UseRealTime();
+
+
+void bm_mt_same_lmessage(benchmark::State& state) {
+  for (auto _ : state) {
+    INSTRMT_LITERAL_MESSAGE("shared");
+  }
+}
+
+BENCHMARK(bm_mt_same_lmessage)->ThreadRange(1, max_threads())->UseRealTime();
+
+
+void bm_mt_same_message(benchmark::State& state) {
+  for (auto _ : state) {
+    INSTRMT_MESSAGE("shared");
+  }
+}
+
+BENCHMARK(bm_mt_same_message)->ThreadRange(1, max_threads())->UseRealTime();
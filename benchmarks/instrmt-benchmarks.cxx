@@ -1,31 +1,99 @@
 #include <benchmark/benchmark.h>
 
-#include "instrmt-benchmarks-functions2.hxx"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
 
-void bm_function1000(benchmark::State& state) {
-  for(auto _ : state) {
-    function1000();
+#include <unistd.h>
+
+#include <instrmt-benchmarks-functions.hxx>
+#include <instrmt-benchmarks-functions2.hxx>
+
+namespace {
+
+// Resident memory of the process, in bytes.
+double resident_memory() {
+  long size = 0, resident = 0;
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm == nullptr)
+    return 0.0;
+  if (fscanf(statm, "%ld %ld", &size, &resident) != 2)
+    resident = 0;
+  fclose(statm);
+  return static_cast<double>(resident) * static_cast<double>(sysconf(_SC_PAGESIZE));
+}
+
+// Contexts are created on the first call of each site, which can only be
+// measured once per process: these benchmarks must run before the others.
+template<void (*F)()>
+void first_call(benchmark::State& state, int sites) {
+  static bool called = false;
+  if (called) {
+    state.SkipWithError("Sites already initialized");
+    return;
+  }
+  called = true;
+
+  double rss = 0.0;
+  for (auto _ : state) {
+    rss = resident_memory();
+    const auto start = std::chrono::steady_clock::now();
+    F();
+    const auto end = std::chrono::steady_clock::now();
+    rss = resident_memory() - rss;
+    state.SetIterationTime(std::chrono::duration<double>(end - start).count());
   }
+
+  state.counters["sites"] = sites;
+  state.counters["per_site"] = benchmark::Counter(sites, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+  state.counters["rss_per_site"] = benchmark::Counter(sites > 0 ? rss / sites : 0.0, benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+}
+
+// Calls F `calls` times per iteration.
+template<void (*F)()>
+void steady_state(benchmark::State& state, int sites, std::int64_t calls = 1) {
+  for (auto _ : state) {
+    for (std::int64_t i = 0; i < calls; ++i)
+      F();
+  }
+
+  state.counters["sites"] = sites;
+  state.counters["per_site"] = benchmark::Counter(static_cast<double>(sites * calls),
+                                                  benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+}
+
+} // anonymous namespace
+
+void bm_functions_first_call(benchmark::State& state) {
+  first_call<all_functions>(state, benchmark_sites);
+}
+
+BENCHMARK(bm_functions_first_call)->Unit(benchmark::TimeUnit::kMicrosecond)->Iterations(1)->UseManualTime();
+
+
+void bm_lmessages_first_call(benchmark::State& state) {
+  first_call<all_literal_messages>(state, benchmark_literal_messages);
+}
+
+BENCHMARK(bm_lmessages_first_call)->Unit(benchmark::TimeUnit::kMicrosecond)->Iterations(1)->UseManualTime();
+
+
+void bm_function1000(benchmark::State& state) {
+  steady_state<all_functions>(state, benchmark_sites);
 }
 
 BENCHMARK(bm_function1000)->Unit(benchmark::TimeUnit::kMicrosecond);
 
 
 void bm_lmessage1000(benchmark::State& state) {
-  for(auto _ : state) {
-    for(int64_t i = 0; i < state.range(0); ++i)
-      lmessage1000();
-  }
+  steady_state<all_literal_messages>(state, benchmark_literal_messages, state.range(0));
 }
 
 BENCHMARK(bm_lmessage1000)->Unit(benchmark::TimeUnit::kMicrosecond)->Arg(1)->Arg(1000);
 
 
 void bm_message1000(benchmark::State& state) {
-  for(auto _ : state) {
-    for(int64_t i = 0; i < state.range(0); ++i)
-      message1000();
-  }
+  steady_state<all_messages>(state, benchmark_messages, state.range(0));
 }
 
 BENCHMARK(bm_message1000)->Unit(benchmark::TimeUnit::kMicrosecond)->Arg(1)->Arg(1000);
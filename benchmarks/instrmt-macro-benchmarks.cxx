@@ -0,0 +1,383 @@
+#include <benchmark/benchmark.h>
+
+#include <instrmt/instrmt.hxx>
+#include <instrmt/details/perf-counters.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Small workloads instrumented at different granularities, to measure how
+// much the instrumentation perturbs the code it measures: compare the time
+// and the cache misses with the ones of instrmt-macro-benchmarks-disable.
+//
+// Cache misses and instructions are those of the benchmark thread and of the
+// worker threads started by the workloads, when the kernel allows to count
+// them.
+
+namespace {
+
+enum Granularity {
+  coarse = 0, // A few regions per workload.
+  medium = 1, // A region per batch of work.
+  fine = 2    // A region per elementary operation.
+};
+
+const char* granularity_name(int granularity) {
+  switch (granularity) {
+  case coarse: return "coarse";
+  case medium: return "medium";
+  default: return "fine";
+  }
+}
+
+std::vector<std::uint64_t> random_values(std::size_t count) {
+  std::mt19937_64 generator(42);
+  std::vector<std::uint64_t> values(count);
+  for (auto& value : values)
+    value = generator();
+  return values;
+}
+
+// Whether the benchmark thread counts its cache misses, and the counts of the
+// worker threads that ended since they were last added to its own.
+std::atomic<bool> counting{false};
+std::atomic<std::uint64_t> worker_totals[2];
+
+// Counts the cache misses of a worker thread, during its whole lifetime.
+class WorkerCacheMisses {
+private:
+  std::unique_ptr<instrmt::perf::CounterGroup> group;
+  std::uint64_t start[2] = {0, 0};
+
+public:
+  WorkerCacheMisses() {
+    if (!counting.load(std::memory_order_relaxed))
+      return;
+    try {
+      group.reset(new instrmt::perf::CounterGroup({instrmt::perf::Counter::cache_misses, instrmt::perf::Counter::instructions}));
+      group->read(start);
+    } catch (...) {
+      // Out of file descriptors, the thread is not counted.
+    }
+  }
+
+  WorkerCacheMisses(const WorkerCacheMisses&) = delete;
+  WorkerCacheMisses& operator=(const WorkerCacheMisses&) = delete;
+
+  ~WorkerCacheMisses() {
+    if (!group)
+      return;
+    std::uint64_t end[2];
+    group->read(end);
+    worker_totals[0].fetch_add(end[0] - start[0], std::memory_order_relaxed);
+    worker_totals[1].fetch_add(end[1] - start[1], std::memory_order_relaxed);
+  }
+};
+
+// Counts the cache misses of the calling thread, and of the worker threads
+// (see WorkerCacheMisses), during the benchmark.
+class CacheMisses {
+private:
+  std::unique_ptr<instrmt::perf::CounterGroup> group;
+  std::uint64_t start[2] = {0, 0};
+  std::uint64_t total[2] = {0, 0};
+
+public:
+  CacheMisses() {
+    try {
+      group.reset(new instrmt::perf::CounterGroup({instrmt::perf::Counter::cache_misses, instrmt::perf::Counter::instructions}));
+    } catch (...) {
+      // Not allowed by the kernel, or not supported by the CPU.
+      return;
+    }
+    worker_totals[0].store(0, std::memory_order_relaxed);
+    worker_totals[1].store(0, std::memory_order_relaxed);
+    counting.store(true, std::memory_order_relaxed);
+  }
+
+  CacheMisses(const CacheMisses&) = delete;
+  CacheMisses& operator=(const CacheMisses&) = delete;
+
+  ~CacheMisses() {
+    counting.store(false, std::memory_order_relaxed);
+  }
+
+  void resume() {
+    if (group)
+      group->read(start);
+  }
+
+  // The worker threads are joined by the workloads, their counts are complete.
+  void pause() {
+    if (!group)
+      return;
+    std::uint64_t end[2];
+    group->read(end);
+    total[0] += end[0] - start[0] + worker_totals[0].exchange(0, std::memory_order_relaxed);
+    total[1] += end[1] - start[1] + worker_totals[1].exchange(0, std::memory_order_relaxed);
+  }
+
+  void report(benchmark::State& state) const {
+    state.SetLabel(granularity_name(static_cast<int>(state.range(0))));
+    if (!group)
+      return;
+    state.counters["cache_misses"] = benchmark::Counter(static_cast<double>(total[0]), benchmark::Counter::kAvgIterations);
+    state.counters["misses_per_kinstr"] = total[1] > 0 ? 1000.0 * static_cast<double>(total[0]) / static_cast<double>(total[1]) : 0.0;
+  }
+};
+
+template<typename Workload>
+void run(benchmark::State& state, const Workload& workload) {
+  CacheMisses misses;
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto input = workload.prepare();
+    state.ResumeTiming();
+
+    misses.resume();
+    workload.run(input, static_cast<int>(state.range(0)));
+    misses.pause();
+
+    benchmark::DoNotOptimize(input);
+  }
+  misses.report(state);
+}
+
+// Parallel merge sort: the halves are sorted by new threads down to a given
+// depth, then sequentially, and merged.
+struct Sort {
+  static constexpr std::size_t size = 1 << 20;
+  static constexpr std::size_t medium_size = 1 << 14;
+  static constexpr std::size_t leaf_size = 64;
+
+  std::vector<std::uint64_t> values = random_values(size);
+  int parallel_depth = 0;
+
+  Sort() {
+    for (unsigned threads = std::max(1u, std::thread::hardware_concurrency()); threads > 1; threads /= 2)
+      ++parallel_depth;
+  }
+
+  std::vector<std::uint64_t> prepare() const { return values; }
+
+  static void sort(std::uint64_t* begin, std::uint64_t* end, int depth, int granularity) {
+    const std::size_t n = static_cast<std::size_t>(end - begin);
+    if (granularity == fine || (granularity == medium && n >= medium_size)) {
+      INSTRMT_REGION("sort");
+      sort_impl(begin, end, depth, granularity);
+    } else {
+      sort_impl(begin, end, depth, granularity);
+    }
+  }
+
+  static void sort_impl(std::uint64_t* begin, std::uint64_t* end, int depth, int granularity) {
+    const std::size_t n = static_cast<std::size_t>(end - begin);
+    if (n <= leaf_size) {
+      std::sort(begin, end);
+      return;
+    }
+
+    std::uint64_t* middle = begin + n / 2;
+    if (depth > 0) {
+      std::thread t([=]() {
+        WorkerCacheMisses misses;
+        if (granularity == coarse) {
+          INSTRMT_REGION("sort thread");
+          sort(begin, middle, depth - 1, granularity);
+        } else {
+          sort(begin, middle, depth - 1, granularity);
+        }
+      });
+      sort(middle, end, depth - 1, granularity);
+      t.join();
+    } else {
+      sort(begin, middle, 0, granularity);
+      sort(middle, end, 0, granularity);
+    }
+    std::inplace_merge(begin, middle, end);
+  }
+
+  void run(std::vector<std::uint64_t>& input, int granularity) const {
+    INSTRMT_REGION("parallel sort");
+    sort(input.data(), input.data() + input.size(), parallel_depth, granularity);
+  }
+};
+
+// Builds a hash map, then looks up as many keys, half of them missing.
+struct HashMap {
+  static constexpr std::size_t size = 1 << 18;
+  static constexpr std::size_t batch_size = 1024;
+
+  std::vector<std::uint64_t> keys = random_values(2 * size);
+
+  const std::vector<std::uint64_t>* prepare() const { return &keys; }
+
+  template<typename F>
+  static void batched(std::size_t count, int granularity, F f) {
+    for (std::size_t batch = 0; batch < count; batch += batch_size) {
+      const std::size_t end = std::min(count, batch + batch_size);
+      if (granularity == medium) {
+        INSTRMT_REGION("batch");
+        for (std::size_t i = batch; i < end; ++i)
+          f(i);
+      } else if (granularity == fine) {
+        for (std::size_t i = batch; i < end; ++i) {
+          INSTRMT_REGION("operation");
+          f(i);
+        }
+      } else {
+        for (std::size_t i = batch; i < end; ++i)
+          f(i);
+      }
+    }
+  }
+
+  void run(const std::vector<std::uint64_t>* input, int granularity) const {
+    const std::vector<std::uint64_t>& k = *input;
+    std::unordered_map<std::uint64_t, std::uint64_t> map;
+    std::uint64_t found = 0;
+
+    {
+      INSTRMT_REGION("build");
+      batched(size, granularity, [&](std::size_t i) { map.emplace(k[i], i); });
+    }
+
+    {
+      INSTRMT_REGION("probe");
+      // Even keys are in the map, odd ones are not.
+      batched(size, granularity, [&](std::size_t i) {
+        const auto it = map.find(k[(i % 2 == 0) ? i : size + i]);
+        if (it != map.end())
+          found += it->second;
+      });
+    }
+
+    benchmark::DoNotOptimize(found);
+  }
+};
+
+// A producer computes items, a consumer (the benchmark thread) folds them,
+// through a bounded queue.
+struct Pipeline {
+  static constexpr std::size_t items = 1 << 15;
+  static constexpr std::size_t item_size = 64;
+  static constexpr std::size_t capacity = 256;
+  static constexpr std::size_t batch_size = 64;
+
+  struct Queue {
+    std::mutex mutex;
+    std::condition_variable not_empty, not_full;
+    std::deque<std::vector<std::uint64_t>> items;
+  };
+
+  int prepare() const { return 0; }
+
+  static std::vector<std::uint64_t> produce(std::size_t i) {
+    std::vector<std::uint64_t> item(item_size);
+    std::uint64_t x = i + 1;
+    for (auto& v : item) {
+      x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+      v = x;
+    }
+    return item;
+  }
+
+  static std::uint64_t consume(const std::vector<std::uint64_t>& item) {
+    std::uint64_t sum = 0;
+    for (auto v : item)
+      sum = sum * 31 + v;
+    return sum;
+  }
+
+  static void push(Queue& queue, std::vector<std::uint64_t> item) {
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    queue.not_full.wait(lock, [&]() { return queue.items.size() < capacity; });
+    queue.items.push_back(std::move(item));
+    queue.not_empty.notify_one();
+  }
+
+  static std::vector<std::uint64_t> pop(Queue& queue) {
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    queue.not_empty.wait(lock, [&]() { return !queue.items.empty(); });
+    std::vector<std::uint64_t> item = std::move(queue.items.front());
+    queue.items.pop_front();
+    queue.not_full.notify_one();
+    return item;
+  }
+
+  void run(int, int granularity) const {
+    Queue queue;
+
+    std::thread producer([&]() {
+      WorkerCacheMisses misses;
+      INSTRMT_REGION("producer");
+      for (std::size_t i = 0; i < items; ++i) {
+        if (granularity == fine) {
+          INSTRMT_REGION("produce");
+          push(queue, produce(i));
+        } else if (granularity == medium && i % batch_size == 0) {
+          INSTRMT_REGION("produce batch");
+          for (std::size_t j = i; j < i + batch_size && j < items; ++j)
+            push(queue, produce(j));
+          i += batch_size - 1;
+        } else {
+          push(queue, produce(i));
+        }
+      }
+    });
+
+    std::uint64_t sum = 0;
+    {
+      INSTRMT_REGION("consumer");
+      for (std::size_t i = 0; i < items; ++i) {
+        if (granularity == fine) {
+          INSTRMT_REGION("consume");
+          sum += consume(pop(queue));
+        } else if (granularity == medium && i % batch_size == 0) {
+          INSTRMT_REGION("consume batch");
+          for (std::size_t j = i; j < i + batch_size && j < items; ++j)
+            sum += consume(pop(queue));
+          i += batch_size - 1;
+        } else {
+          sum += consume(pop(queue));
+        }
+      }
+    }
+
+    producer.join();
+    benchmark::DoNotOptimize(sum);
+  }
+};
+
+} // anonymous namespace
+
+void bm_sort(benchmark::State& state) {
+  static const Sort workload;
+  run(state, workload);
+}
+
+BENCHMARK(bm_sort)->DenseRange(coarse, fine)->Unit(benchmark::TimeUnit::kMillisecond)->UseRealTime();
+
+
+void bm_hash_map(benchmark::State& state) {
+  static const HashMap workload;
+  run(state, workload);
+}
+
+BENCHMARK(bm_hash_map)->DenseRange(coarse, fine)->Unit(benchmark::TimeUnit::kMillisecond)->UseRealTime();
+
+
+void bm_pipeline(benchmark::State& state) {
+  run(state, Pipeline());
+}
+
+BENCHMARK(bm_pipeline)->DenseRange(coarse, fine)->Unit(benchmark::TimeUnit::kMillisecond)->UseRealTime();
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""Runs the benchmarks under every engine and wrapper of a build directory.
+
+Usage: run-benchmarks.py [-b BUILD_DIR] [-o OUT_DIR] [-- BENCHMARK_ARGS...]
+
+instrmt-benchmarks is run once per MODULE engine (every libinstrmt-*.so of
+the build directory), the static wrappers (instrmt-benchmarks-tty, -itt,
+-tracy) once each. The cost of the instrumentation is the time per site minus
+the one of instrmt-benchmarks-disable, it is printed in nanoseconds per region,
+literal message and dynamic message.
+
+The instrmt-macro-benchmarks* executables are run the same way, their slowdown
+and change of cache misses per 1000 instructions are printed relative to
+instrmt-macro-benchmarks-disable.
+
+The raw results are kept in OUT_DIR, one JSON file per run, so that they can be
+compared with compare-benchmarks.py.
+"""
+
+import argparse
+import glob
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+# Steady-state benchmarks, and the column they are reported in.
+BENCHMARKS = [
+    ('bm_function1000', 'region'),
+    ('bm_lmessage1000/1', 'literal'),
+    ('bm_message1000/1', 'message'),
+]
+
+
+# Keeps the engines from flooding the terminal or the disk.
+def engine_environment(out_dir):
+    return {
+        'INSTRMT_TTY_OUT': os.devnull,
+        'INSTRMT_TRACE_OUT': os.path.join(out_dir, 'instrmt.trace'),
+    }
+
+
+def run(name, command, env, out_dir, args, filter=None):
+    out = os.path.join(out_dir, name + '.json')
+    full_env = dict(os.environ)
+    full_env.update(env)
+    print('Running {}'.format(name), file=sys.stderr)
+    filter_args = ['--benchmark_filter=' + filter] if filter else []
+    subprocess.run([command] + filter_args +
+                   ['--benchmark_out=' + out,
+                    '--benchmark_out_format=json'] + args,
+                   env=full_env, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, check=True)
+
+    with open(out) as f:
+        return json.load(f)['benchmarks']
+
+
+def average(results, metric):
+    """Value of a metric for each benchmark, averaged over the repetitions if any."""
+    values = {}
+    for b in results:
+        if b.get('run_type', 'iteration') != 'iteration' or metric not in b:
+            continue
+        values.setdefault(b.get('run_name', b['name']), []).append(b[metric])
+    return {k: sum(v) / len(v) for k, v in values.items()}
+
+
+# The first `left` columns are aligned to the left, the others to the right.
+def print_table(header, rows, left=2):
+    widths = [max(len(r[i]) for r in rows + [header]) for i in range(len(header))]
+    for r in [header] + rows:
+        print('  '.join(v.ljust(w) if i < left else v.rjust(w) for i, (v, w) in enumerate(zip(r, widths))))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('-b', '--build-dir', default='.', help='build directory (default: current directory)')
+    parser.add_argument('-o', '--out-dir', help='where to keep the JSON results (default: a temporary directory)')
+    parser.add_argument('args', nargs='*', help='arguments passed to the benchmarks')
+    options = parser.parse_args()
+
+    build_dir = os.path.abspath(options.build_dir)
+    out_dir = options.out_dir or tempfile.mkdtemp(prefix='instrmt-benchmarks.')
+    os.makedirs(out_dir, exist_ok=True)
+    env = engine_environment(out_dir)
+
+    def executable(name):
+        path = os.path.join(build_dir, name)
+        return path if os.access(path, os.X_OK) else None
+
+    baseline_exe = executable('instrmt-benchmarks-disable')
+    if baseline_exe is None:
+        sys.exit('instrmt-benchmarks-disable not found in {}'.format(build_dir))
+
+    runs = []
+    dynamic_exe = executable('instrmt-benchmarks')
+    if dynamic_exe is not None:
+        runs.append(('none', 'dynamic', '', {}))
+        for engine in sorted(glob.glob(os.path.join(build_dir, 'libinstrmt-*.so'))):
+            name = os.path.basename(engine)[len('libinstrmt-'):-len('.so')]
+            runs.append((name, 'dynamic', '', {'INSTRMT_ENGINE': engine}))
+    for name in ('tty', 'itt', 'tracy'):
+        if executable('instrmt-benchmarks-' + name) is not None:
+            runs.append((name, 'static', '-' + name, {}))
+
+    filter = '^(' + '|'.join(b for b, _ in BENCHMARKS) + ')$'
+    baseline = average(run('disable', baseline_exe, env, out_dir, options.args, filter), 'per_site')
+
+    rows = []
+    for engine, wrapper, suffix, engine_env in runs:
+        run_env = dict(env)
+        run_env.update(engine_env)
+        results = average(run('{}-{}'.format(wrapper, engine), executable('instrmt-benchmarks' + suffix),
+                              run_env, out_dir, options.args, filter), 'per_site')
+        row = [engine, wrapper]
+        for b, _ in BENCHMARKS:
+            if b in results and b in baseline:
+                row.append('{:.1f}'.format((results[b] - baseline[b]) * 1e9))
+            else:
+                row.append('-')
+        rows.append(row)
+
+    print_table(['engine', 'wrapper'] + ['ns/' + c for _, c in BENCHMARKS], rows)
+
+    macro_baseline_exe = executable('instrmt-macro-benchmarks-disable')
+    if macro_baseline_exe is None:
+        print('Results kept in {}'.format(out_dir), file=sys.stderr)
+        return
+
+    macro_baseline = run('macro-disable', macro_baseline_exe, env, out_dir, options.args)
+    baseline_time = average(macro_baseline, 'real_time')
+    baseline_misses = average(macro_baseline, 'misses_per_kinstr')
+    labels = {b.get('run_name', b['name']): b.get('label', '') for b in macro_baseline}
+
+    rows = []
+    for engine, wrapper, suffix, engine_env in runs:
+        exe = executable('instrmt-macro-benchmarks' + suffix)
+        if exe is None:
+            continue
+        run_env = dict(env)
+        run_env.update(engine_env)
+        results = run('macro-{}-{}'.format(wrapper, engine), exe, run_env, out_dir, options.args)
+        time = average(results, 'real_time')
+        misses = average(results, 'misses_per_kinstr')
+        for b in baseline_time:
+            if b not in time:
+                continue
+            name = '{} ({})'.format(b.split('/')[0], labels[b]) if labels.get(b) else b
+            slowdown = 'x{:.2f}'.format(time[b] / baseline_time[b]) if baseline_time[b] else '-'
+            delta = '{:+.2f}'.format(misses[b] - baseline_misses[b]) if b in misses and b in baseline_misses else '-'
+            rows.append([engine, wrapper, name, slowdown, delta])
+
+    print()
+    print_table(['engine', 'wrapper', 'workload', 'slowdown', 'misses/kinstr'], rows, left=3)
+    print('Results kept in {}'.format(out_dir), file=sys.stderr)
+
+if __name__ == '__main__':
+    main()
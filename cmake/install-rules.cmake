@@ -7,6 +7,7 @@ mark_as_advanced(CMAKE_INSTALL_CMAKEDIR)
 install(
   TARGETS
   instrmt instrmt-noop
+  instrmt-compose-wrapper
   EXPORT InstrmtTargets
 )
 
@@ -14,12 +15,36 @@ install(
   TARGETS
   instrmt-tty
   instrmt-tty-wrapper
+  instrmt-tty-policy
   EXPORT InstrmtTargets
   LIBRARY DESTINATION ${CMAKE_INSTALL_LIBDIR}
 )
 
+install(
+  TARGETS
+  instrmt-shm
+  instrmt-trace
+  LIBRARY DESTINATION ${CMAKE_INSTALL_LIBDIR}
+)
+
+if (INSTRMT_BUILD_STATIC_ENGINES)
+  install(
+    TARGETS
+    instrmt-tty-static
+    instrmt-shm-static
+    instrmt-trace-static
+    EXPORT InstrmtTargets
+    ARCHIVE DESTINATION ${CMAKE_INSTALL_LIBDIR}
+  )
+endif()
+
+if (INSTRMT_BUILD_TOOLS)
+  install(TARGETS instrmt-tail instrmt-report)
+endif()
+
 install(FILES
   instrmt/tty/tty-utils.h
+  instrmt/tty/tty-policy.hxx
   instrmt/tty/tty-wrapper.hxx
   DESTINATION ${CMAKE_INSTALL_INCLUDEDIR}/instrmt/tty)
 
@@ -28,12 +53,17 @@ if (INSTRMT_BUILD_ITT_ENGINE)
     TARGETS
     instrmt-itt
     instrmt-itt-wrapper
+    instrmt-itt-policy
     EXPORT InstrmtTargets
     LIBRARY DESTINATION ${CMAKE_INSTALL_LIBDIR}
   )
 
+  if (INSTRMT_BUILD_STATIC_ENGINES)
+    install(TARGETS instrmt-itt-static EXPORT InstrmtTargets ARCHIVE DESTINATION ${CMAKE_INSTALL_LIBDIR})
+  endif()
+
   install(
-    FILES instrmt/itt/itt-wrapper.hxx
+    FILES instrmt/itt/itt-policy.hxx instrmt/itt/itt-wrapper.hxx
     DESTINATION ${CMAKE_INSTALL_INCLUDEDIR}/instrmt/itt
   )
 endif()
@@ -43,12 +73,17 @@ if (INSTRMT_BUILD_TRACY_ENGINE)
     TARGETS
     instrmt-tracy
     instrmt-tracy-wrapper
+    instrmt-tracy-policy
     EXPORT InstrmtTargets
     LIBRARY DESTINATION ${CMAKE_INSTALL_LIBDIR}
   )
 
+  if (INSTRMT_BUILD_STATIC_ENGINES)
+    install(TARGETS instrmt-tracy-static EXPORT InstrmtTargets ARCHIVE DESTINATION ${CMAKE_INSTALL_LIBDIR})
+  endif()
+
   install(
-    FILES instrmt/tracy/tracy-wrapper.hxx
+    FILES instrmt/tracy/tracy-policy.hxx instrmt/tracy/tracy-wrapper.hxx
     DESTINATION ${CMAKE_INSTALL_INCLUDEDIR}/instrmt/tracy
   )
 endif()
@@ -58,24 +93,35 @@ install(
   DESTINATION ${CMAKE_INSTALL_INCLUDEDIR}/instrmt
 )
 
+install(
+  FILES instrmt/compose/compose-wrapper.hxx
+  DESTINATION ${CMAKE_INSTALL_INCLUDEDIR}/instrmt/compose
+)
+
 install(
   FILES
   instrmt/details/utils.h
   instrmt/details/utils.hxx
   instrmt/details/base.hxx
+  instrmt/details/compose.hxx
   instrmt/details/engine.hxx
+  instrmt/details/format.hxx
+  instrmt/details/function-name.hxx
+  instrmt/details/level.h
+  instrmt/details/scoped-region.hxx
+  instrmt/details/site-id.hxx
   DESTINATION ${CMAKE_INSTALL_INCLUDEDIR}/instrmt/details
 )
 
 # Create the export file for the build tree.
-export(TARGETS instrmt instrmt-noop instrmt-tty-wrapper FILE "${CMAKE_CURRENT_BINARY_DIR}/InstrmtTargets.cmake")
+export(TARGETS instrmt instrmt-noop instrmt-tty-wrapper instrmt-compose-wrapper instrmt-tty-policy FILE "${CMAKE_CURRENT_BINARY_DIR}/InstrmtTargets.cmake")
 
 if (INSTRMT_BUILD_ITT_ENGINE)
-  export(TARGETS instrmt-itt-wrapper APPEND FILE "${CMAKE_CURRENT_BINARY_DIR}/InstrmtTargets.cmake")
+  export(TARGETS instrmt-itt-wrapper instrmt-itt-policy APPEND FILE "${CMAKE_CURRENT_BINARY_DIR}/InstrmtTargets.cmake")
 endif()
 
 if (INSTRMT_BUILD_TRACY_ENGINE)
-  export(TARGETS instrmt-tracy-wrapper APPEND FILE "${CMAKE_CURRENT_BINARY_DIR}/InstrmtTargets.cmake")
+  export(TARGETS instrmt-tracy-wrapper instrmt-tracy-policy APPEND FILE "${CMAKE_CURRENT_BINARY_DIR}/InstrmtTargets.cmake")
 endif()
 
 # Create the export file for the install tree.
@@ -103,10 +149,13 @@ write_basic_package_version_file(
 )
 
 install(
-  FILES "${CMAKE_CURRENT_BINARY_DIR}/InstrmtConfigVersion.cmake"
+  FILES "${CMAKE_CURRENT_BINARY_DIR}/InstrmtConfigVersion.cmake" cmake/instrmt-macros.cmake
   DESTINATION ${CMAKE_INSTALL_CMAKEDIR}
 )
 
+# find_itt_module() for the config file of the build tree.
+configure_file(cmake/instrmt-macros.cmake "${CMAKE_CURRENT_BINARY_DIR}/instrmt-macros.cmake" COPYONLY)
+
 install(
   FILES "${CMAKE_CURRENT_BINARY_DIR}/InstrmtConfig.install.cmake"
   DESTINATION ${CMAKE_INSTALL_CMAKEDIR}
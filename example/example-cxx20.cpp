@@ -0,0 +1,30 @@
+#include <instrmt/instrmt.hxx>
+
+#include <thread>
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+void f() {
+  instrmt::scoped_function fn;
+
+  {
+    instrmt::scoped_region<"g1"> g1;
+
+    std::this_thread::sleep_for(10ms);
+  }
+
+  instrmt::scoped_region<"g2"> g2;
+
+  std::this_thread::sleep_for(10ms);
+
+  g2.reset();
+}
+
+int main(int, char**) {
+  instrmt::scoped_region<"main"> r;
+
+  f();
+  f();
+  return 0;
+}
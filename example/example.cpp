@@ -37,7 +37,12 @@ int main(int, char**) {
   f();
 
   std::string m = "Second call";
-  INSTRMT_MESSAGE(m.c_str());
+  INSTRMT_MESSAGE(m);
   f();
+
+  INSTRMT_MESSAGEF("Called f() %d times in %s", 2, __FUNCTION__);
+  INSTRMT_LITERAL_MESSAGE_DEBUG("Debug message");
+  INSTRMT_MESSAGE_WARN(m.c_str());
+  INSTRMT_MESSAGE_N(m.data(), 6);
   return 0;
 }
@@ -0,0 +1,128 @@
+#ifndef INSTRMTCOMPOSEWRAPPER_HXX
+#define INSTRMTCOMPOSEWRAPPER_HXX
+
+// Static wrapper forwarding to several static wrappers at once, selected by
+// INSTRMT_COMPOSE_TTY, INSTRMT_COMPOSE_ITT and INSTRMT_COMPOSE_TRACY (see the
+// instrmt-*-policy CMake targets).
+
+#include <instrmt/details/compose.hxx>
+#include <instrmt/details/format.hxx>
+#include <instrmt/details/utils.h>
+
+#include <string>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+#ifdef INSTRMT_COMPOSE_TTY
+#include <instrmt/tty/tty-policy.hxx>
+#endif
+
+#ifdef INSTRMT_COMPOSE_ITT
+#include <instrmt/itt/itt-policy.hxx>
+#endif
+
+#ifdef INSTRMT_COMPOSE_TRACY
+#include <instrmt/tracy/tracy-policy.hxx>
+#endif
+
+namespace instrmt {
+namespace compose {
+
+template<typename... Policies>
+struct policies {
+  typedef ::instrmt::site<Policies...> site;
+  typedef ::instrmt::region<Policies...> region;
+  typedef ::instrmt::literal_message_site<Policies...> literal_message_site;
+
+  static void emit_message(const char* msg) {
+    ::instrmt::emit_message<Policies...>(msg);
+  }
+
+  static void emit_message(const char* msg, std::size_t len) {
+    ::instrmt::emit_message<Policies...>(msg, len);
+  }
+
+  static void emit_message(const std::string& msg) {
+    ::instrmt::emit_message<Policies...>(msg.data(), msg.size());
+  }
+
+#if __cplusplus >= 201703L
+  static void emit_message(std::string_view msg) {
+    ::instrmt::emit_message<Policies...>(msg.data(), msg.size());
+  }
+#endif
+};
+
+template<typename P1, typename P2>
+struct concat;
+
+template<typename... P1, typename... P2>
+struct concat<policies<P1...>, policies<P2...>> {
+  typedef policies<P1..., P2...> type;
+};
+
+#ifdef INSTRMT_COMPOSE_TTY
+typedef policies<TTYPolicy> tty_policies;
+#else
+typedef policies<> tty_policies;
+#endif
+
+#ifdef INSTRMT_COMPOSE_ITT
+typedef policies<ITTPolicy> itt_policies;
+#else
+typedef policies<> itt_policies;
+#endif
+
+#ifdef INSTRMT_COMPOSE_TRACY
+typedef policies<TracyPolicy> tracy_policies;
+#else
+typedef policies<> tracy_policies;
+#endif
+
+typedef concat<concat<tty_policies, itt_policies>::type, tracy_policies>::type selected;
+
+} // namespace compose
+} // namespace instrmt
+
+#define INSTRMT_NAMED_REGION(VAR, NAME) \
+  static const ::instrmt::compose::selected::site INSTRMTCONCAT(VAR, _instrmt_compose_site)(NAME, __FUNCTION__, __FILE__, __LINE__); \
+  ::instrmt::compose::selected::region INSTRMTCONCAT(VAR, _instrmt_compose_region)(INSTRMTCONCAT(VAR, _instrmt_compose_site))
+
+#define INSTRMT_NAMED_REGION_BEGIN(VAR, NAME) INSTRMT_NAMED_REGION(VAR, NAME)
+
+#define INSTRMT_NAMED_REGION_END(VAR) INSTRMTCONCAT(VAR, _instrmt_compose_region).terminate()
+
+#define INSTRMT_REGION(NAME) INSTRMT_NAMED_REGION(_, NAME)
+
+#define INSTRMT_REGION_BEGIN(NAME) INSTRMT_NAMED_REGION(_, NAME)
+
+#define INSTRMT_REGION_END() INSTRMT_NAMED_REGION_END(_)
+
+#ifdef INSTRMT_QUALIFIED_FUNCTION_NAMES
+#define INSTRMT_FUNCTION() INSTRMT_QUALIFIED_FUNCTION()
+#else
+#define INSTRMT_FUNCTION() INSTRMT_NAMED_REGION(_, __FUNCTION__)
+#endif
+
+#define INSTRMT_NAMED_LITERAL_MESSAGE(VAR, MSG) \
+  static const ::instrmt::compose::selected::literal_message_site INSTRMTCONCAT(VAR, _instrmt_compose_msg_site)(MSG); \
+  INSTRMTCONCAT(VAR, _instrmt_compose_msg_site).emit()
+
+#define INSTRMT_LITERAL_MESSAGE(MSG) \
+  INSTRMT_NAMED_LITERAL_MESSAGE(_, MSG)
+
+#define INSTRMT_MESSAGE(MSG) \
+  ::instrmt::compose::selected::emit_message(MSG)
+
+#define INSTRMT_MESSAGE_N(MSG, LEN) \
+  ::instrmt::compose::selected::emit_message(MSG, LEN)
+
+#define INSTRMT_NAMED_MESSAGEF(VAR, ...) \
+  ::instrmt::compose::selected::emit_message(::instrmt::format::now(__VA_ARGS__))
+
+#define INSTRMT_MESSAGEF(...) \
+  INSTRMT_NAMED_MESSAGEF(_, __VA_ARGS__)
+
+#endif // INSTRMTCOMPOSEWRAPPER_HXX
@@ -1,6 +1,7 @@
 #ifndef INSTRMTCORE_HXX
 #define INSTRMTCORE_HXX
 
+#include <cstddef>
 #include <memory>
 
 namespace instrmt {
@@ -10,7 +11,11 @@ public:
   virtual ~Region() = default;
 };
 
+class ScopedRegion;
+
 class RegionContext {
+  friend class ScopedRegion;
+
 protected:
   virtual Region* make_region_ptr() { return nullptr; }
 
@@ -30,6 +35,14 @@ public:
   virtual void emit_message() const {}
 };
 
+class FormattedMessageContext {
+public:
+  virtual ~FormattedMessageContext() = default;
+
+  // args holds the arguments captured by format::encode().
+  virtual void emit_message(const void* /*args*/, std::size_t /*size*/) const {}
+};
+
 } // namespace instrmt
 
 #endif // INSTRMTCORE_HXX
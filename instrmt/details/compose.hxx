@@ -0,0 +1,131 @@
+#ifndef INSTRMTCOMPOSE_HXX
+#define INSTRMTCOMPOSE_HXX
+
+#include <cstddef>
+#include <cstring>
+#include <tuple>
+#include <utility>
+
+// Composition of static wrappers, resolved at compile time: no virtual call,
+// no engine to load. Each policy provides:
+//
+//   struct Site;                // Per site data, Site(name, function, file, line).
+//   struct Region;              // Region(const Site&), terminate(), ends on destruction.
+//                               // terminate() must be idempotent: it is called
+//                               // by the composed region, then by ~Region().
+//   struct LiteralMessageSite;  // Per site data, LiteralMessageSite(msg).
+//   static void emit_literal_message(const LiteralMessageSite&);
+//   static void emit_message(const char* msg, size_t len);
+//
+// See TTYPolicy, ITTPolicy and TracyPolicy, e.g.:
+//
+//   static const instrmt::site<instrmt::TTYPolicy, instrmt::TracyPolicy> s("f", __FUNCTION__, __FILE__, __LINE__);
+//   instrmt::region<instrmt::TTYPolicy, instrmt::TracyPolicy> r(s);
+
+namespace instrmt {
+
+namespace details {
+
+// Regions of the policies. The head is a member declared before the tail: it
+// begins before and ends after the regions of the following policies (the
+// construction order of the elements of a std::tuple is unspecified).
+template<typename... Policies>
+struct regions {
+  regions() {}
+  void terminate() {}
+};
+
+template<typename Head, typename... Tail>
+struct regions<Head, Tail...> {
+  typename Head::Region head;
+  regions<Tail...> tail;
+
+  explicit regions(const typename Head::Site& site, const typename Tail::Site&... sites)
+    : head(site)
+    , tail(sites...)
+  {}
+
+  void terminate() {
+    tail.terminate();
+    head.terminate();
+  }
+};
+
+} // namespace details
+
+template<typename... Policies>
+class site {
+private:
+  template<typename...> friend class region;
+
+  std::tuple<typename Policies::Site...> sites;
+
+public:
+  site(const char* name, const char* function, const char* file, int line)
+    : sites(typename Policies::Site(name, function, file, line)...)
+  {}
+};
+
+// Regions begin in the order of the policies, and end in the reverse order.
+template<typename... Policies>
+class region {
+private:
+  details::regions<Policies...> regions;
+
+  template<std::size_t... I>
+  region(const site<Policies...>& s, std::index_sequence<I...>)
+    : regions(std::get<I>(s.sites)...)
+  {}
+
+public:
+  explicit region(const site<Policies...>& s)
+    : region(s, std::index_sequence_for<Policies...>())
+  {}
+
+  region(const region&) = delete;
+  region& operator=(const region&) = delete;
+
+  void terminate() {
+    regions.terminate();
+  }
+
+  ~region() {
+    terminate();
+  }
+};
+
+template<typename... Policies>
+class literal_message_site {
+private:
+  std::tuple<typename Policies::LiteralMessageSite...> sites;
+
+  template<std::size_t... I>
+  void emit(std::index_sequence<I...>) const {
+    const int expand[] = {0, (Policies::emit_literal_message(std::get<I>(sites)), 0)...};
+    (void)expand;
+  }
+
+public:
+  explicit literal_message_site(const char* msg)
+    : sites(typename Policies::LiteralMessageSite(msg)...)
+  {}
+
+  void emit() const {
+    emit(std::index_sequence_for<Policies...>());
+  }
+};
+
+template<typename... Policies>
+void emit_message(const char* msg, std::size_t len) {
+  const int expand[] = {0, (Policies::emit_message(msg, len), 0)...};
+  (void)expand;
+}
+
+template<typename... Policies>
+void emit_message(const char* msg) {
+  emit_message<Policies...>(msg, std::strlen(msg));
+}
+
+} // namespace instrmt
+
+#endif // INSTRMTCOMPOSE_HXX
@@ -1,19 +1,30 @@
 #include <instrmt/details/engine.hxx>
 
+#ifndef INSTRMT_STATIC_ENGINE
 #include <dlfcn.h>
+#endif
+#include <cstring>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include <instrmt/details/base.hxx>
+#include <instrmt/details/rate-limiting.hxx>
+#include <instrmt/details/sampling.hxx>
+#include <instrmt/details/throttling.hxx>
 #include <instrmt/details/utils.hxx>
 
 using instrmt::ansi::style;
 
 namespace {
 
+instrmt::InstrmtEngine engine = {nullptr, nullptr, nullptr, nullptr};
+
+#ifndef INSTRMT_STATIC_ENGINE
 typedef instrmt::InstrmtEngine EngineFactory();
 
 void* handle = nullptr;
-instrmt::InstrmtEngine engine = {nullptr, nullptr, nullptr};
 
 template<typename F>
 F* load_function(const char* lib, const char* name) {
@@ -29,7 +40,110 @@ F* load_function(const char* lib, const char* name) {
 
   return f;
 }
+#endif
+
+void configure_sampling() {
+  const char* rate = getenv("INSTRMT_SAMPLE_RATE");
+  if (rate == nullptr)
+    return;
+
+  try {
+    instrmt::sampling::enable(instrmt::sampling::parse_rate(rate));
+  } catch (const std::exception& ex) {
+    std::cerr << style::red_bg << "[INSTRMT] " << ex.what() << ", sampling disabled" << style::reset << std::endl;
+    return;
+  }
+
+  if (instrmt::sampling::enabled())
+    std::cerr << style::green_fg << "[INSTRMT] Sampling region trees at rate " << rate << style::reset << std::endl;
+}
+
+void configure_throttling() {
+  const char* budget = getenv("INSTRMT_THROTTLE");
+  if (budget == nullptr)
+    return;
+
+  try {
+    std::size_t end = 0;
+    const double value = std::stod(budget, &end);
+    if (budget[end] != '\0' || !(value > 0.0))
+      throw std::invalid_argument(budget);
+    instrmt::throttling::enable(value);
+  } catch (const std::logic_error&) {
+    std::cerr << style::red_bg << "[INSTRMT] Invalid throttling budget: " << budget << ", throttling disabled" << style::reset << std::endl;
+    return;
+  }
+
+  std::cerr << style::green_fg << "[INSTRMT] Throttling regions shorter than " << budget << "x their overhead" << style::reset << std::endl;
+}
+
+// Used when the engine cannot defer formatting.
+class ImmediateFormattedMessageContext : public instrmt::FormattedMessageContext {
+private:
+  const char* fmt;
+  const char* types;
+
+public:
+  ImmediateFormattedMessageContext(const char* fmt, const char* types)
+    : instrmt::FormattedMessageContext()
+    , fmt(fmt)
+    , types(types)
+  {}
+
+  void emit_message(const void* args, std::size_t size) const override {
+    const std::string msg = instrmt::format::format(fmt, types, args, size);
+    engine.dynamic_message_sender(msg.data(), msg.size());
+  }
+};
+
+// Sends the pending summaries of suppressed messages at exit.
+struct RateLimitingGuard {
+  ~RateLimitingGuard() {
+    instrmt::rate_limiting::shutdown();
+  }
+};
+
+void configure_rate_limiting() {
+  const char* rate = getenv("INSTRMT_MESSAGE_RATE");
+  if (rate == nullptr || engine.dynamic_message_sender == nullptr)
+    return;
+
+  try {
+    std::size_t end = 0;
+    const double value = std::stod(rate, &end);
+    if (rate[end] != '\0' || !(value > 0.0))
+      throw std::invalid_argument(rate);
+    instrmt::rate_limiting::enable(value, engine.dynamic_message_sender);
+  } catch (const std::logic_error&) {
+    std::cerr << style::red_bg << "[INSTRMT] Invalid message rate: " << rate << ", rate limiting disabled" << style::reset << std::endl;
+    return;
+  }
+
+  std::cerr << style::green_fg << "[INSTRMT] Limiting messages to " << rate << " per second and per message" << style::reset << std::endl;
+
+  // Created after the engine, so destroyed before it.
+  static RateLimitingGuard guard;
+}
+
+#ifdef INSTRMT_STATIC_ENGINE
+} // anonymous namespace
+
+// Defined by the engine linked in the same library.
+extern "C" instrmt::InstrmtEngine make_instrmt_engine_v2();
+
+namespace {
 
+int load_engine() {
+  std::cerr << style::green_fg << "[INSTRMT] Initializing static engine " << INSTRMT_STATIC_ENGINE << style::reset << std::endl;
+  engine = make_instrmt_engine_v2();
+
+  configure_sampling();
+  configure_throttling();
+  configure_rate_limiting();
+
+  return 1;
+}
+#else
 int load_engine() {
   const char* engine_lib = getenv("INSTRMT_ENGINE");
   if (engine_lib == nullptr) {
@@ -42,14 +156,22 @@ int load_engine() {
     return 0;
   }
 
-  EngineFactory* make_engine = load_function<EngineFactory>(engine_lib, "make_instrmt_engine");
-  if (make_engine) {
-    std::cerr << style::green_fg << "[INSTRMT] Initializing engine " << engine_lib << style::reset << std::endl;
-    engine = make_engine();
+  EngineFactory* make_engine = load_function<EngineFactory>(engine_lib, "make_instrmt_engine_v2");
+  if (make_engine == nullptr) {
+    std::cerr << style::red_bg << "[INSTRMT] " << engine_lib << " is not an engine for this version of instrmt" << style::reset << std::endl;
+    return 0;
   }
 
+  std::cerr << style::green_fg << "[INSTRMT] Initializing engine " << engine_lib << style::reset << std::endl;
+  engine = make_engine();
+
+  configure_sampling();
+  configure_throttling();
+  configure_rate_limiting();
+
   return 1;
 }
+#endif
 
 int engine_guard()
 {
@@ -57,29 +179,114 @@ int engine_guard()
   return g;
 }
 
+// Contexts of the sites, created after the engine so that they are destroyed
+// before it.
+struct SiteContexts {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<instrmt::RegionContext>> regions;
+  std::vector<std::unique_ptr<instrmt::LiteralMessageContext>> literal_messages;
+  std::vector<std::unique_ptr<instrmt::FormattedMessageContext>> formatted_messages;
+};
+
+SiteContexts& site_contexts() {
+  (void)engine_guard();
+  static SiteContexts contexts;
+  return contexts;
+}
+
+// Used by the sites when there is no engine.
+instrmt::RegionContext no_region_context;
+const instrmt::LiteralMessageContext no_literal_message_context;
+const instrmt::FormattedMessageContext no_formatted_message_context;
+
 } // anonymous namespace
 
 namespace instrmt {
 
+RegionContext* init_region_site(RegionSite& site)
+{
+  SiteContexts& contexts = site_contexts();
+  std::lock_guard<std::mutex> lock(contexts.mutex);
+
+  RegionContext* ctx = site.ctx.load(std::memory_order_relaxed);
+  if (ctx != nullptr)
+    return ctx;
+
+  std::unique_ptr<RegionContext> owned = make_region_context(site.name, site.function, site.file, site.line, site.id);
+  if (owned) {
+    ctx = owned.get();
+    contexts.regions.push_back(std::move(owned));
+  } else {
+    ctx = &no_region_context;
+  }
+
+  site.ctx.store(ctx, std::memory_order_release);
+  return ctx;
+}
+
+const LiteralMessageContext* init_literal_message_site(LiteralMessageSite& site)
+{
+  SiteContexts& contexts = site_contexts();
+  std::lock_guard<std::mutex> lock(contexts.mutex);
+
+  const LiteralMessageContext* ctx = site.ctx.load(std::memory_order_relaxed);
+  if (ctx != nullptr)
+    return ctx;
+
+  std::unique_ptr<LiteralMessageContext> owned = make_literal_message_context(site.msg, site.id);
+  if (owned) {
+    ctx = owned.get();
+    contexts.literal_messages.push_back(std::move(owned));
+  } else {
+    ctx = &no_literal_message_context;
+  }
+
+  site.ctx.store(ctx, std::memory_order_release);
+  return ctx;
+}
+
+const FormattedMessageContext* init_formatted_message_site(FormattedMessageSite& site)
+{
+  SiteContexts& contexts = site_contexts();
+  std::lock_guard<std::mutex> lock(contexts.mutex);
+
+  const FormattedMessageContext* ctx = site.ctx.load(std::memory_order_relaxed);
+  if (ctx != nullptr)
+    return ctx;
+
+  std::unique_ptr<FormattedMessageContext> owned = make_formatted_message_context(site.fmt, site.types, site.file, site.line, site.id);
+  if (owned) {
+    ctx = owned.get();
+    contexts.formatted_messages.push_back(std::move(owned));
+  } else {
+    ctx = &no_formatted_message_context;
+  }
+
+  site.ctx.store(ctx, std::memory_order_release);
+  return ctx;
+}
+
 std::unique_ptr<RegionContext> make_region_context(const char* name,
                                                    const char* function,
                                                    const char* file,
-                                                   int line)
+                                                   int line,
+                                                   std::uint64_t id)
 {
   (void)engine_guard();
 
   if (engine.region_context_factory)
-    return std::unique_ptr<RegionContext>(engine.region_context_factory(name, function, file, line));
+    return std::unique_ptr<RegionContext>(sampling::wrap(throttling::wrap(engine.region_context_factory(name, function, file, line, id), name ? name : function)));
   else
     return {};
 }
 
-std::unique_ptr<LiteralMessageContext> make_literal_message_context(const char* msg)
+std::unique_ptr<LiteralMessageContext> make_literal_message_context(const char* msg,
+                                                                   std::uint64_t id)
 {
   (void)engine_guard();
 
   if (engine.literal_message_context_factory)
-    return std::unique_ptr<LiteralMessageContext>(engine.literal_message_context_factory(msg));
+    return std::unique_ptr<LiteralMessageContext>(sampling::wrap(rate_limiting::wrap(engine.literal_message_context_factory(msg, id), msg)));
   else
     return {};
 }
@@ -87,8 +294,34 @@ std::unique_ptr<LiteralMessageContext> make_literal_message_context(const char*
 void emit_message(const char* msg) {
   (void)engine_guard();
 
-  if (engine.dynamic_message_sender)
-    engine.dynamic_message_sender(msg);
+  if (engine.dynamic_message_sender && !sampling::discarded()) {
+    const std::size_t len = std::strlen(msg);
+    if (rate_limiting::allow(msg, len))
+      engine.dynamic_message_sender(msg, len);
+  }
+}
+
+void emit_message(const char* msg, std::size_t len) {
+  (void)engine_guard();
+
+  if (engine.dynamic_message_sender && !sampling::discarded() && rate_limiting::allow(msg, len))
+    engine.dynamic_message_sender(msg, len);
+}
+
+std::unique_ptr<FormattedMessageContext> make_formatted_message_context(const char* fmt,
+                                                                       const char* types,
+                                                                       const char* file,
+                                                                       int line,
+                                                                       std::uint64_t id)
+{
+  (void)engine_guard();
+
+  if (engine.formatted_message_context_factory)
+    return std::unique_ptr<FormattedMessageContext>(sampling::wrap(rate_limiting::wrap(engine.formatted_message_context_factory(fmt, types, file, line, id), fmt)));
+  else if (engine.dynamic_message_sender)
+    return std::unique_ptr<FormattedMessageContext>(sampling::wrap(rate_limiting::wrap(new ImmediateFormattedMessageContext(fmt, types), fmt)));
+  else
+    return {};
 }
 
 } // namespace instrmt
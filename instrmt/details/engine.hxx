@@ -2,22 +2,48 @@
 #define INSTRMTDYNAMIC_HXX
 
 #include <instrmt/details/base.hxx>
+#include <instrmt/details/format.hxx>
+#include <instrmt/details/site-id.hxx>
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 namespace instrmt {
 
+// id is the site_id() of the site.
 typedef RegionContext* RegionContextFactory(const char* /*name*/,
                                             const char* /*function*/,
                                             const char* /*file*/,
-                                            int /*line*/);
+                                            int /*line*/,
+                                            std::uint64_t /*id*/);
 
-typedef LiteralMessageContext* LiteralMessageContextFactory(const char* /*msg*/);
+typedef LiteralMessageContext* LiteralMessageContextFactory(const char* /*msg*/,
+                                                            std::uint64_t /*id*/);
 
-typedef void DynamicMessageSender(const char* /*msg*/);
+// msg is not necessarily NUL terminated.
+typedef void DynamicMessageSender(const char* /*msg*/, std::size_t /*len*/);
 
+// types is the format::Signature of the call site.
+typedef FormattedMessageContext* FormattedMessageContextFactory(const char* /*fmt*/,
+                                                                const char* /*types*/,
+                                                                const char* /*file*/,
+                                                                int /*line*/,
+                                                                std::uint64_t /*id*/);
+
+// Returned by the `extern "C" InstrmtEngine make_instrmt_engine_v2()` function
+// of the engines. The suffix is bumped whenever this struct or the factories
+// change, so that engines built for another version are rejected.
 struct InstrmtEngine {
   RegionContextFactory* region_context_factory;
   LiteralMessageContextFactory* literal_message_context_factory;
   DynamicMessageSender* dynamic_message_sender;
+  // Optional, formatted messages are sent to dynamic_message_sender otherwise.
+  FormattedMessageContextFactory* formatted_message_context_factory;
 };
 
 } // namespace instrmt
@@ -27,12 +53,123 @@ namespace instrmt {
 std::unique_ptr<RegionContext> make_region_context(const char* name,
                                                    const char* function,
                                                    const char* file,
-                                                   int line);
+                                                   int line,
+                                                   std::uint64_t id);
+
+std::unique_ptr<LiteralMessageContext> make_literal_message_context(const char* msg,
+                                                                   std::uint64_t id);
+
+#if defined(__GNUC__)
+#define INSTRMT_COLD __attribute__((cold, noinline))
+#define INSTRMT_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define INSTRMT_COLD
+#define INSTRMT_UNLIKELY(x) (x)
+#endif
+
+// Call site of a region. Sites are constant-initialized by the macros: no
+// initialization guard nor destructor is emitted for them, the context is
+// created out of line on the first call and owned by the library.
+struct RegionSite {
+  const char* name;
+  const char* function;
+  const char* file;
+  int line;
+  std::uint64_t id;
+  std::atomic<RegionContext*> ctx;
+};
 
-std::unique_ptr<LiteralMessageContext> make_literal_message_context(const char* msg);
+// Returns the context of the site, a context creating no region when there is
+// no engine.
+INSTRMT_COLD RegionContext* init_region_site(RegionSite& site);
+
+class ScopedRegion {
+private:
+  Region* region;
+
+public:
+  explicit ScopedRegion(RegionSite& site) {
+    RegionContext* ctx = site.ctx.load(std::memory_order_acquire);
+    if (INSTRMT_UNLIKELY(ctx == nullptr))
+      ctx = init_region_site(site);
+    region = ctx->make_region_ptr();
+  }
+
+  ScopedRegion(const ScopedRegion&) = delete;
+  ScopedRegion& operator=(const ScopedRegion&) = delete;
+
+  ~ScopedRegion() {
+    delete region;
+  }
+
+  void reset() {
+    delete region;
+    region = nullptr;
+  }
+};
+
+// Call site of a literal message, see RegionSite.
+struct LiteralMessageSite {
+  const char* msg;
+  std::uint64_t id;
+  std::atomic<const LiteralMessageContext*> ctx;
+};
+
+// Returns the context of the site, a context emitting nothing when there is
+// no engine.
+INSTRMT_COLD const LiteralMessageContext* init_literal_message_site(LiteralMessageSite& site);
+
+inline void emit_literal_message(LiteralMessageSite& site) {
+  const LiteralMessageContext* ctx = site.ctx.load(std::memory_order_acquire);
+  if (INSTRMT_UNLIKELY(ctx == nullptr))
+    ctx = init_literal_message_site(site);
+  ctx->emit_message();
+}
 
 void emit_message(const char* msg);
 
+void emit_message(const char* msg, std::size_t len);
+
+inline void emit_message(const std::string& msg) {
+  emit_message(msg.data(), msg.size());
+}
+
+#if __cplusplus >= 201703L
+inline void emit_message(std::string_view msg) {
+  emit_message(msg.data(), msg.size());
+}
+#endif
+
+std::unique_ptr<FormattedMessageContext> make_formatted_message_context(const char* fmt,
+                                                                       const char* types,
+                                                                       const char* file,
+                                                                       int line,
+                                                                       std::uint64_t id);
+
+// Call site of a formatted message, see RegionSite. types is the
+// format::Signature of the site.
+struct FormattedMessageSite {
+  const char* fmt;
+  const char* types;
+  const char* file;
+  int line;
+  std::uint64_t id;
+  std::atomic<const FormattedMessageContext*> ctx;
+};
+
+// Returns the context of the site, a context emitting nothing when there is
+// no engine.
+INSTRMT_COLD const FormattedMessageContext* init_formatted_message_site(FormattedMessageSite& site);
+
+template<typename... Args>
+void emit_formatted_message(FormattedMessageSite& site, const char* fmt, const Args&... args) {
+  const FormattedMessageContext* ctx = site.ctx.load(std::memory_order_acquire);
+  if (INSTRMT_UNLIKELY(ctx == nullptr))
+    ctx = init_formatted_message_site(site);
+  char buffer[format::max_size];
+  ctx->emit_message(buffer, format::encode(buffer, fmt, args...));
+}
+
 } // namespace instrmt
 
 #endif // INSTRMTDYNAMIC_HXX
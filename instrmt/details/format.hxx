@@ -0,0 +1,286 @@
+#ifndef INSTRMTFORMAT_HXX
+#define INSTRMTFORMAT_HXX
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+// Deferred formatting of printf-like messages.
+//
+// The format string and the types of the arguments are known once per call
+// site, only the raw values of the arguments are captured when a message is
+// emitted. Integers are stored as 32 or 64 bits values, floating point values
+// as doubles, pointers as 64 bits values, and strings are copied (length on 16
+// bits, then the characters). The message is formatted later, possibly in
+// another process, from the format string, the types and the captured values.
+//
+// Supported conversions are those of printf, except `%n` and `*` widths or
+// precisions. Length modifiers are ignored, the captured type is used instead.
+
+namespace instrmt {
+namespace format {
+
+constexpr std::size_t max_args = 8;
+
+// Captured arguments never exceed this size, longer strings are truncated.
+constexpr std::size_t max_size = 256;
+
+namespace details {
+
+template<typename T, typename Enable = void>
+struct TypeCode;
+
+template<typename T>
+struct TypeCode<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type> {
+  static constexpr char value = sizeof(T) <= 4 ? 'i' : 'l';
+};
+
+template<typename T>
+struct TypeCode<T, typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type> {
+  static constexpr char value = sizeof(T) <= 4 ? 'u' : 'U';
+};
+
+template<typename T>
+struct TypeCode<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+  static constexpr char value = 'f';
+};
+
+template<typename T>
+struct TypeCode<T, typename std::enable_if<std::is_enum<T>::value>::type>
+  : TypeCode<typename std::underlying_type<T>::type>
+{};
+
+template<>
+struct TypeCode<char*> {
+  static constexpr char value = 's';
+};
+
+template<>
+struct TypeCode<const char*> {
+  static constexpr char value = 's';
+};
+
+template<typename T>
+struct TypeCode<T*, typename std::enable_if<!std::is_same<typename std::remove_cv<T>::type, char>::value>::type> {
+  static constexpr char value = 'p';
+};
+
+template<>
+struct TypeCode<std::nullptr_t> {
+  static constexpr char value = 'p';
+};
+
+inline std::size_t put(char* buffer, std::size_t size, const void* value, std::size_t len) {
+  if (size + len > max_size)
+    return max_size + 1;
+  std::memcpy(buffer + size, value, len);
+  return size + len;
+}
+
+template<typename T>
+std::size_t encode_one(char* buffer, std::size_t size, T value) {
+  switch (TypeCode<T>::value) {
+  case 'i': { const std::int32_t v = static_cast<std::int32_t>(value); return put(buffer, size, &v, sizeof(v)); }
+  case 'l': { const std::int64_t v = static_cast<std::int64_t>(value); return put(buffer, size, &v, sizeof(v)); }
+  case 'u': { const std::uint32_t v = static_cast<std::uint32_t>(value); return put(buffer, size, &v, sizeof(v)); }
+  case 'U': { const std::uint64_t v = static_cast<std::uint64_t>(value); return put(buffer, size, &v, sizeof(v)); }
+  default:  { const double v = static_cast<double>(value); return put(buffer, size, &v, sizeof(v)); }
+  }
+}
+
+template<typename T>
+std::size_t encode_one(char* buffer, std::size_t size, T* value) {
+  const std::uint64_t v = reinterpret_cast<std::uintptr_t>(value);
+  return put(buffer, size, &v, sizeof(v));
+}
+
+inline std::size_t encode_string(char* buffer, std::size_t size, const char* value) {
+  if (value == nullptr)
+    value = "(null)";
+  if (size + sizeof(std::uint16_t) > max_size)
+    return max_size + 1;
+
+  const std::size_t len = std::strlen(value);
+  const std::size_t available = max_size - size - sizeof(std::uint16_t);
+  const std::uint16_t stored = static_cast<std::uint16_t>(len < available ? len : available);
+  std::memcpy(buffer + size, &stored, sizeof(stored));
+  std::memcpy(buffer + size + sizeof(stored), value, stored);
+  return size + sizeof(stored) + stored;
+}
+
+inline std::size_t encode_one(char* buffer, std::size_t size, const char* value) {
+  return encode_string(buffer, size, value);
+}
+
+inline std::size_t encode_one(char* buffer, std::size_t size, char* value) {
+  return encode_string(buffer, size, value);
+}
+
+inline std::size_t encode_one(char* buffer, std::size_t size, std::nullptr_t) {
+  const std::uint64_t v = 0;
+  return put(buffer, size, &v, sizeof(v));
+}
+
+inline std::size_t encode(char*, std::size_t size) {
+  return size;
+}
+
+// Arguments that do not fit are dropped.
+template<typename T, typename... Args>
+std::size_t encode(char* buffer, std::size_t size, const T& value, const Args&... args) {
+  const std::size_t next = encode_one(buffer, size, static_cast<typename std::decay<const T>::type>(value));
+  if (next > max_size)
+    return size;
+  return encode(buffer, next, args...);
+}
+
+} // namespace details
+
+// Types of the arguments of a call site, as a NUL terminated string of type codes.
+template<typename... Args>
+struct Signature {
+  static_assert(sizeof...(Args) <= max_args, "Too many arguments for a formatted message");
+  static constexpr char types[sizeof...(Args) + 1] = {details::TypeCode<typename std::decay<Args>::type>::value..., '\0'};
+};
+
+template<typename... Args>
+constexpr char Signature<Args...>::types[sizeof...(Args) + 1];
+
+// Only used in unevaluated contexts, to get the signature of a call site.
+template<typename... Args>
+Signature<Args...> signature(const char* fmt, const Args&... args);
+
+#if defined(__GNUC__)
+#define INSTRMT_PRINTF_FORMAT __attribute__((format(printf, 1, 2)))
+#else
+#define INSTRMT_PRINTF_FORMAT
+#endif
+
+// Only used in unevaluated contexts, lets the compiler check the arguments against the format.
+int check(const char* fmt, ...) INSTRMT_PRINTF_FORMAT;
+
+// Captures the arguments in buffer, which must hold at least max_size bytes.
+// Returns the number of bytes used.
+template<typename... Args>
+std::size_t encode(char* buffer, const char* /*fmt*/, const Args&... args) {
+  return details::encode(buffer, 0, args...);
+}
+
+// Formats a message from its captured arguments. Arguments missing from a
+// truncated capture are replaced by their conversion specification.
+inline std::string format(const char* fmt, const char* types, const void* data, std::size_t size) {
+  const char* args = static_cast<const char*>(data);
+  std::size_t offset = 0;
+  std::string out;
+
+  for (const char* p = fmt; *p;) {
+    if (*p != '%') {
+      out += *p++;
+      continue;
+    }
+
+    if (p[1] == '%') {
+      out += '%';
+      p += 2;
+      continue;
+    }
+
+    // Flags, width and precision are kept, length modifiers are dropped.
+    const char* start = p++;
+    std::string spec = "%";
+    while (*p && std::strchr("-+ #0", *p))
+      spec += *p++;
+    while (*p && ((*p >= '0' && *p <= '9') || *p == '.'))
+      spec += *p++;
+    while (*p && std::strchr("hlLqjzt", *p))
+      ++p;
+
+    const char conversion = *p;
+    if (conversion == '\0' || !std::strchr("diouxXeEfFgGaAcsp", conversion)) {
+      out.append(start, static_cast<std::size_t>(p - start));
+      continue;
+    }
+    ++p;
+
+    const char type = *types;
+    std::size_t len = 0;
+    switch (type) {
+    case 'i': case 'u': len = 4; break;
+    case 'l': case 'U': case 'f': case 'p': len = 8; break;
+    case 's': len = 2; break;
+    default: break;
+    }
+
+    if (len == 0 || offset + len > size) {
+      out.append(start, static_cast<std::size_t>(p - start));
+      continue;
+    }
+    ++types;
+
+    std::int64_t i = 0;
+    double f = 0.0;
+    std::string s;
+    switch (type) {
+    case 'i': { std::int32_t v; std::memcpy(&v, args + offset, 4); i = v; f = v; break; }
+    case 'u': { std::uint32_t v; std::memcpy(&v, args + offset, 4); i = v; f = v; break; }
+    case 'l': { std::int64_t v; std::memcpy(&v, args + offset, 8); i = v; f = static_cast<double>(v); break; }
+    case 'U': case 'p': { std::uint64_t v; std::memcpy(&v, args + offset, 8); i = static_cast<std::int64_t>(v); f = static_cast<double>(v); break; }
+    case 'f': { std::memcpy(&f, args + offset, 8); i = static_cast<std::int64_t>(f); break; }
+    case 's': {
+      std::uint16_t n;
+      std::memcpy(&n, args + offset, 2);
+      const std::size_t available = size - offset - 2;
+      s.assign(args + offset + 2, n < available ? n : available);
+      len += n;
+      break;
+    }
+    }
+    offset += len;
+
+    char buffer[512];
+    int written = 0;
+    switch (conversion) {
+    case 'd': case 'i':
+      written = std::snprintf(buffer, sizeof(buffer), (spec + "lld").c_str(), static_cast<long long>(i));
+      break;
+    case 'o': case 'u': case 'x': case 'X':
+      written = std::snprintf(buffer, sizeof(buffer), (spec + "ll" + conversion).c_str(), static_cast<unsigned long long>(i));
+      break;
+    case 'c':
+      written = std::snprintf(buffer, sizeof(buffer), (spec + "c").c_str(), static_cast<int>(i));
+      break;
+    case 's':
+      if (type != 's')
+        s = std::to_string(i);
+      written = std::snprintf(buffer, sizeof(buffer), (spec + "s").c_str(), s.c_str());
+      break;
+    case 'p':
+      written = std::snprintf(buffer, sizeof(buffer), (spec + "p").c_str(), reinterpret_cast<void*>(static_cast<std::uintptr_t>(i)));
+      break;
+    default:
+      written = std::snprintf(buffer, sizeof(buffer), (spec + conversion).c_str(), f);
+      break;
+    }
+
+    if (written > 0)
+      out.append(buffer, static_cast<std::size_t>(written) < sizeof(buffer) ? static_cast<std::size_t>(written) : sizeof(buffer) - 1);
+  }
+
+  return out;
+}
+
+// Formats a message immediately, for engines that cannot defer it.
+template<typename... Args>
+std::string now(const char* fmt, const Args&... args) {
+  char buffer[max_size];
+  const std::size_t size = encode(buffer, fmt, args...);
+  return format(fmt, Signature<Args...>::types, buffer, size);
+}
+
+} // namespace format
+} // namespace instrmt
+
+#endif // INSTRMTFORMAT_HXX
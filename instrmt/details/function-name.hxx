@@ -0,0 +1,91 @@
+#ifndef INSTRMTFUNCTIONNAME_HXX
+#define INSTRMTFUNCTIONNAME_HXX
+
+#include <cstddef>
+
+// Qualified function names, used by INSTRMT_FUNCTION() when
+// INSTRMT_QUALIFIED_FUNCTION_NAMES is defined.
+//
+// __FUNCTION__ only holds the unqualified name of the function, so overloads,
+// template instantiations and methods of different classes share the same
+// name. The name is derived instead from __PRETTY_FUNCTION__, minus the return
+// type, e.g. `ns::Foo<T>::bar(int) const [with T = double]`. The trimming is
+// done at compile time, the name is stored once per site.
+
+namespace instrmt {
+namespace function_name {
+
+template<std::size_t N>
+struct Name {
+  char data[N];
+};
+
+namespace details {
+
+constexpr bool starts_with(const char* p, const char* prefix) {
+  while (*prefix != '\0') {
+    if (*p++ != *prefix++)
+      return false;
+  }
+  return true;
+}
+
+// Offset of the qualified name, after the return type.
+constexpr std::size_t begin(const char* p, std::size_t n) {
+  std::size_t result = 0;
+  int depth = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    if (starts_with(p + i, "(anonymous namespace)")) {
+      i += sizeof("(anonymous namespace)") - 2;
+      continue;
+    }
+
+    // The symbol of an operator (e.g. `operator<`, `operator()`) is not a
+    // bracket, and the name of a conversion operator contains spaces.
+    if (depth == 0 && starts_with(p + i, "operator") && (i == 0 || p[i - 1] == ':' || p[i - 1] == ' '))
+      return result;
+
+    const char c = p[i];
+    if (c == '(' && depth == 0)
+      return result;
+    if (c == '<' || c == '(' || c == '[')
+      ++depth;
+    else if (c == '>' || c == ')' || c == ']')
+      --depth;
+    else if (c == ' ' && depth == 0)
+      result = i + 1;
+  }
+  return result;
+}
+
+} // namespace details
+
+template<std::size_t N>
+constexpr Name<N> trim(const char (&pretty_function)[N]) {
+  Name<N> name{};
+  const std::size_t first = details::begin(pretty_function, N - 1);
+  for (std::size_t i = first; i + 1 < N; ++i)
+    name.data[i - first] = pretty_function[i];
+  return name;
+}
+
+} // namespace function_name
+} // namespace instrmt
+
+// Function of the region sites of the dynamic wrapper, hashed in their id.
+#if defined(INSTRMT_QUALIFIED_FUNCTION_NAMES) && defined(__GNUC__)
+#define INSTRMTSITEFUNCTION __PRETTY_FUNCTION__
+#else
+#define INSTRMTSITEFUNCTION __FUNCTION__
+#endif
+
+#if defined(__GNUC__)
+#define INSTRMT_QUALIFIED_FUNCTION() \
+  static constexpr auto _instrmt_function_name = ::instrmt::function_name::trim(__PRETTY_FUNCTION__); \
+  INSTRMT_NAMED_REGION(_, _instrmt_function_name.data)
+#else
+#define INSTRMT_QUALIFIED_FUNCTION() \
+  INSTRMT_NAMED_REGION(_, __FUNCTION__)
+#endif
+
+#endif // INSTRMTFUNCTIONNAME_HXX
@@ -0,0 +1,39 @@
+#ifndef INSTRMTLEVEL_H
+#define INSTRMTLEVEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INSTRMT_LEVEL_DEBUG 0
+#define INSTRMT_LEVEL_INFO 1
+#define INSTRMT_LEVEL_WARN 2
+
+// Minimum level of the messages compiled in.
+#ifndef INSTRMT_MIN_LEVEL
+#define INSTRMT_MIN_LEVEL INSTRMT_LEVEL_DEBUG
+#endif
+
+// Runtime threshold, read from INSTRMT_LEVEL (debug, info or warn, default: debug).
+// Invalid values are reported once, and the default is used instead.
+inline int instrmt_level_threshold() {
+  static const int threshold = []() {
+    const char* value = getenv("INSTRMT_LEVEL");
+    if (value == nullptr || strcmp(value, "debug") == 0)
+      return INSTRMT_LEVEL_DEBUG;
+    if (strcmp(value, "info") == 0)
+      return INSTRMT_LEVEL_INFO;
+    if (strcmp(value, "warn") == 0)
+      return INSTRMT_LEVEL_WARN;
+    fprintf(stderr, "\033[41m[INSTRMT] Invalid value for INSTRMT_LEVEL: %s, using debug\033[0m\n", value);
+    return INSTRMT_LEVEL_DEBUG;
+  }();
+  return threshold;
+}
+
+// Only evaluated once per call site, the result is kept in a static flag.
+inline bool instrmt_level_enabled(int level) {
+  return level >= instrmt_level_threshold();
+}
+
+#endif // INSTRMTLEVEL_H
@@ -0,0 +1,202 @@
+#include "perf-counters.hxx"
+
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+
+struct CounterInfo {
+  instrmt::perf::Counter counter;
+  const char* name;
+  std::uint32_t type;
+  std::uint64_t config;
+};
+
+const CounterInfo counter_infos[] = {
+  {instrmt::perf::Counter::instructions,  "instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+  {instrmt::perf::Counter::cycles,        "cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+  {instrmt::perf::Counter::cache_misses,  "cache-misses",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+  {instrmt::perf::Counter::branch_misses, "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+  {instrmt::perf::Counter::task_clock,    "task-clock",    PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+  {instrmt::perf::Counter::page_faults,   "page-faults",   PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+const CounterInfo& info(instrmt::perf::Counter counter) {
+  return counter_infos[static_cast<std::size_t>(counter)];
+}
+
+int perf_event_open(perf_event_attr* attr, int group_fd) {
+  return static_cast<int>(syscall(SYS_perf_event_open, attr, 0 /* this thread */, -1 /* any cpu */, group_fd, 0));
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+inline std::uint64_t read_pmc(std::uint32_t counter) {
+  std::uint32_t low, high;
+  __asm__ volatile("rdpmc" : "=a" (low), "=d" (high) : "c" (counter));
+  return static_cast<std::uint64_t>(high) << 32 | low;
+}
+#define INSTRMT_HAS_RDPMC 1
+#endif
+
+} // anonymous namespace
+
+namespace instrmt {
+namespace perf {
+
+const char* name(Counter counter) {
+  return info(counter).name;
+}
+
+bool is_hardware(Counter counter) {
+  return info(counter).type == PERF_TYPE_HARDWARE;
+}
+
+std::vector<Counter> parse_counters(const std::string& list) {
+  std::vector<Counter> counters;
+
+  std::size_t begin = 0;
+  while (begin <= list.size()) {
+    std::size_t end = list.find(',', begin);
+    if (end == std::string::npos)
+      end = list.size();
+
+    const std::string item = list.substr(begin, end - begin);
+    if (!item.empty()) {
+      bool found = false;
+      for (const CounterInfo& i : counter_infos) {
+        if (item == i.name) {
+          counters.push_back(i.counter);
+          found = true;
+          break;
+        }
+      }
+      if (!found)
+        throw std::runtime_error("unknown counter: " + item);
+    }
+
+    begin = end + 1;
+  }
+
+  if (counters.size() > max_counters)
+    throw std::runtime_error("too many counters: " + list);
+
+  return counters;
+}
+
+CounterGroup::CounterGroup(const std::vector<Counter>& counters)
+  : events()
+  , count(0)
+  , rdpmc(false)
+{
+  const long page_size = sysconf(_SC_PAGESIZE);
+
+  for (Counter counter : counters) {
+    if (count == max_counters)
+      break;
+
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = info(counter).type;
+    attr.config = info(counter).config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    const int fd = perf_event_open(&attr, count == 0 ? -1 : events[0].fd);
+    if (fd < 0) {
+      const int err = errno;
+      close_all();
+      throw std::system_error(err, std::generic_category(), std::string("cannot open counter ") + name(counter));
+    }
+
+    void* page = mmap(nullptr, static_cast<std::size_t>(page_size), PROT_READ, MAP_SHARED, fd, 0);
+    events[count++] = {fd, page == MAP_FAILED ? nullptr : page};
+  }
+
+#ifdef INSTRMT_HAS_RDPMC
+  rdpmc = count > 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto* pc = static_cast<const perf_event_mmap_page*>(events[i].page);
+    rdpmc = rdpmc && pc != nullptr && pc->cap_user_rdpmc;
+  }
+#endif
+}
+
+CounterGroup::~CounterGroup() {
+  close_all();
+}
+
+void CounterGroup::close_all() {
+  const long page_size = sysconf(_SC_PAGESIZE);
+  // Close members before the leader.
+  while (count > 0) {
+    --count;
+    if (events[count].page)
+      munmap(events[count].page, static_cast<std::size_t>(page_size));
+    close(events[count].fd);
+  }
+}
+
+bool CounterGroup::read_rdpmc(std::uint64_t* values) const {
+#ifdef INSTRMT_HAS_RDPMC
+  for (std::size_t i = 0; i < count; ++i) {
+    const volatile perf_event_mmap_page* pc = static_cast<const volatile perf_event_mmap_page*>(events[i].page);
+
+    std::uint32_t seq;
+    std::uint64_t value;
+    do {
+      seq = pc->lock;
+      __asm__ volatile("" ::: "memory");
+
+      const std::uint32_t index = pc->index;
+      // The counter is not currently scheduled on a PMU, rdpmc cannot be used.
+      if (index == 0)
+        return false;
+
+      const unsigned width = pc->pmc_width;
+      if (width == 0)
+        return false;
+
+      // Sign-extend the raw counter value.
+      const std::int64_t pmc = static_cast<std::int64_t>(read_pmc(index - 1) << (64 - width)) >> (64 - width);
+      value = static_cast<std::uint64_t>(pc->offset + pmc);
+
+      __asm__ volatile("" ::: "memory");
+    } while (pc->lock != seq);
+
+    values[i] = value;
+  }
+  return true;
+#else
+  (void)values;
+  return false;
+#endif
+}
+
+void CounterGroup::read_fd(std::uint64_t* values) const {
+  std::uint64_t buffer[1 + max_counters];
+  if (::read(events[0].fd, buffer, sizeof(buffer)) < static_cast<ssize_t>(sizeof(std::uint64_t) * (1 + count))) {
+    std::memset(values, 0, sizeof(std::uint64_t) * count);
+    return;
+  }
+  std::memcpy(values, buffer + 1, sizeof(std::uint64_t) * count);
+}
+
+void CounterGroup::read(std::uint64_t* values) const {
+  if (count == 0)
+    return;
+
+  if (!rdpmc || !read_rdpmc(values))
+    read_fd(values);
+}
+
+} // namespace perf
+} // namespace instrmt
@@ -0,0 +1,64 @@
+#ifndef INSTRMTPERFCOUNTERS_HXX
+#define INSTRMTPERFCOUNTERS_HXX
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace instrmt {
+namespace perf {
+
+enum class Counter {
+  instructions,
+  cycles,
+  cache_misses,
+  branch_misses,
+  task_clock,
+  page_faults
+};
+
+constexpr std::size_t max_counters = 6;
+
+const char* name(Counter counter);
+
+bool is_hardware(Counter counter);
+
+// Parses a comma separated list of counter names (e.g. "instructions,cycles").
+// Throws std::runtime_error on unknown counters.
+std::vector<Counter> parse_counters(const std::string& list);
+
+// Counters from perf_event_open(), attached to the thread that created the group.
+// Values are read with rdpmc when the kernel allows it, and with read() otherwise.
+class CounterGroup {
+private:
+  struct Event {
+    int fd;
+    void* page;
+  };
+
+  Event events[max_counters];
+  std::size_t count;
+  bool rdpmc;
+
+  void close_all();
+  bool read_rdpmc(std::uint64_t* values) const;
+  void read_fd(std::uint64_t* values) const;
+
+public:
+  // Throws std::system_error if a counter cannot be opened.
+  explicit CounterGroup(const std::vector<Counter>& counters);
+  CounterGroup(const CounterGroup&) = delete;
+  CounterGroup& operator=(const CounterGroup&) = delete;
+  ~CounterGroup();
+
+  std::size_t size() const { return count; }
+
+  // Writes size() values.
+  void read(std::uint64_t* values) const;
+};
+
+} // namespace perf
+} // namespace instrmt
+
+#endif // INSTRMTPERFCOUNTERS_HXX
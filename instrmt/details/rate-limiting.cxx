@@ -0,0 +1,330 @@
+#include "rate-limiting.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Suppressed messages are reported at most once per window.
+constexpr std::uint64_t report_window_ns = 1000000000ull;
+
+// Number of distinct dynamic messages tracked by each thread.
+constexpr std::size_t dedup_slots = 64;
+
+// Longest prefix of a dynamic message quoted in the reports.
+constexpr std::size_t dedup_text = 48;
+
+bool rate_limiting_enabled = false;
+std::uint64_t emission_interval_ns = 0;
+std::uint64_t burst_ns = 0;
+instrmt::DynamicMessageSender* report_sender = nullptr;
+
+std::uint64_t now_ns() {
+  return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void report(const char* msg, std::size_t len, std::uint64_t suppressed) {
+  const std::string text = "message \"" + std::string(msg, len) + "\" suppressed " + std::to_string(suppressed) + " times";
+  report_sender(text.data(), text.size());
+}
+
+// Token bucket, implemented as a generic cell rate algorithm: `tat` is the
+// time at which the bucket will be full again. A message is allowed if the
+// bucket is not empty, i.e. if tat is less than one burst ahead of now.
+class TokenBucket {
+private:
+  std::atomic<std::uint64_t> tat{0};
+
+public:
+  // Message quoted in the summaries, set by the owner of the bucket.
+  const char* text = nullptr;
+  std::size_t len = 0;
+
+  // Messages suppressed since the last summary, and whether the bucket is
+  // listed in the summaries.
+  std::atomic<std::uint64_t> suppressed{0};
+  std::atomic<bool> listed{false};
+
+  bool take(std::uint64_t now) {
+    std::uint64_t current = tat.load(std::memory_order_relaxed);
+    for (;;) {
+      const std::uint64_t base = current > now ? current : now;
+      if (base - now > burst_ns)
+        return false;
+      if (tat.compare_exchange_weak(current, base + emission_interval_ns, std::memory_order_relaxed))
+        return true;
+    }
+  }
+
+  void reset() {
+    tat.store(0, std::memory_order_relaxed);
+  }
+};
+
+// Summaries of the suppressed messages. A bucket suppressing a message is
+// listed until the end of the window, then a background thread reports the
+// summaries of all the listed buckets, so that a storm is summarized even once
+// it stopped. Summaries are never sent from the destructors of the buckets,
+// the engine may already be partially destroyed: the counts of the buckets
+// destroyed while listed are kept for the next report, or for shutdown().
+struct Summaries {
+  std::mutex mutex;
+  std::vector<TokenBucket*> buckets;
+  std::vector<std::pair<std::string, std::uint64_t>> orphans;
+
+  // Started by the first suppressed message.
+  std::thread reporter;
+  std::condition_variable wakeup;
+  bool stopped = false;
+};
+
+// End of the current window, UINT64_MAX when no bucket is listed.
+std::atomic<std::uint64_t> next_summary{UINT64_MAX};
+
+Summaries& summaries() {
+  // Never destroyed, buckets may be forgotten during the static destruction.
+  static Summaries* s = new Summaries();
+  return *s;
+}
+
+void run_reporter();
+
+void list(TokenBucket& bucket, std::uint64_t now) {
+  Summaries& s = summaries();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  s.buckets.push_back(&bucket);
+  if (next_summary.load(std::memory_order_relaxed) == UINT64_MAX) {
+    next_summary.store(now + report_window_ns, std::memory_order_relaxed);
+    if (!s.reporter.joinable() && !s.stopped)
+      s.reporter = std::thread(run_reporter);
+    s.wakeup.notify_one();
+  }
+}
+
+// Counts a suppressed message.
+void suppress(TokenBucket& bucket, std::uint64_t now) {
+  bucket.suppressed.fetch_add(1);
+  if (!bucket.listed.load() && !bucket.listed.exchange(true))
+    list(bucket, now);
+}
+
+// Must be called before the bucket is destroyed or its text changes.
+void forget(TokenBucket& bucket) {
+  if (!bucket.listed.load())
+    return;
+
+  Summaries& s = summaries();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  const auto it = std::find(s.buckets.begin(), s.buckets.end(), &bucket);
+  if (it == s.buckets.end())
+    return;
+  s.buckets.erase(it);
+  bucket.listed.store(false);
+  if (const std::uint64_t suppressed = bucket.suppressed.exchange(0))
+    s.orphans.emplace_back(std::string(bucket.text, bucket.len), suppressed);
+}
+
+void summarize(std::uint64_t now) {
+  if (now < next_summary.load(std::memory_order_relaxed))
+    return;
+
+  std::vector<std::pair<std::string, std::uint64_t>> reports;
+  {
+    Summaries& s = summaries();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (now < next_summary.load(std::memory_order_relaxed))
+      return;
+
+    // A message suppressed concurrently is either counted here, or lists
+    // the bucket again.
+    for (TokenBucket* bucket : s.buckets) {
+      bucket->listed.store(false);
+      if (const std::uint64_t suppressed = bucket->suppressed.exchange(0))
+        reports.emplace_back(std::string(bucket->text, bucket->len), suppressed);
+    }
+    for (auto& orphan : s.orphans)
+      reports.push_back(std::move(orphan));
+    s.buckets.clear();
+    s.orphans.clear();
+    next_summary.store(UINT64_MAX, std::memory_order_relaxed);
+  }
+
+  for (const auto& r : reports)
+    report(r.first.data(), r.first.size(), r.second);
+}
+
+// Reports the summaries at the end of each window.
+void run_reporter() {
+  Summaries& s = summaries();
+  std::unique_lock<std::mutex> lock(s.mutex);
+  while (!s.stopped) {
+    const std::uint64_t next = next_summary.load(std::memory_order_relaxed);
+    const std::uint64_t now = now_ns();
+    if (next == UINT64_MAX) {
+      s.wakeup.wait(lock);
+    } else if (now < next) {
+      s.wakeup.wait_for(lock, std::chrono::nanoseconds(next - now));
+    } else {
+      lock.unlock();
+      summarize(now);
+      lock.lock();
+    }
+  }
+}
+
+template<typename Context>
+class RateLimitedContext : public Context {
+protected:
+  std::unique_ptr<Context> ctx;
+  std::string msg;
+  mutable TokenBucket bucket;
+
+  bool take() const {
+    const std::uint64_t now = now_ns();
+    if (bucket.take(now))
+      return true;
+    suppress(bucket, now);
+    return false;
+  }
+
+public:
+  RateLimitedContext(Context* ctx, const char* msg)
+    : Context()
+    , ctx(ctx)
+    , msg(msg ? msg : "")
+  {
+    bucket.text = this->msg.data();
+    bucket.len = this->msg.size();
+  }
+
+  ~RateLimitedContext() {
+    forget(bucket);
+  }
+};
+
+class RateLimitedLiteralMessageContext : public RateLimitedContext<instrmt::LiteralMessageContext> {
+public:
+  using RateLimitedContext::RateLimitedContext;
+
+  void emit_message() const override {
+    if (take())
+      ctx->emit_message();
+  }
+};
+
+class RateLimitedFormattedMessageContext : public RateLimitedContext<instrmt::FormattedMessageContext> {
+public:
+  using RateLimitedContext::RateLimitedContext;
+
+  void emit_message(const void* args, std::size_t size) const override {
+    if (take())
+      ctx->emit_message(args, size);
+  }
+};
+
+std::uint64_t hash(const char* msg, std::size_t len) {
+  std::uint64_t h = 0xcbf29ce484222325ull;
+  for (std::size_t i = 0; i < len; ++i)
+    h = (h ^ static_cast<unsigned char>(msg[i])) * 0x100000001b3ull;
+  return h;
+}
+
+// Dynamic messages are tracked per thread, in a direct mapped table: a
+// message evicted by another one starts over with a full bucket.
+struct DedupSlot {
+  std::uint64_t hash = 0;
+  char text[dedup_text];
+  TokenBucket bucket;
+
+  DedupSlot() {
+    bucket.text = text;
+  }
+};
+
+struct DedupTable {
+  DedupSlot slots[dedup_slots];
+
+  ~DedupTable() {
+    for (DedupSlot& slot : slots)
+      forget(slot.bucket);
+  }
+};
+
+thread_local DedupTable dedup;
+
+} // anonymous namespace
+
+namespace instrmt {
+namespace rate_limiting {
+
+void enable(double rate, DynamicMessageSender* sender) {
+  rate_limiting_enabled = rate > 0.0 && sender != nullptr;
+  emission_interval_ns = static_cast<std::uint64_t>(1e9 / rate);
+  // Below 1 message per second, bursts are limited to 1 message.
+  burst_ns = emission_interval_ns < report_window_ns ? report_window_ns - emission_interval_ns : 0;
+  report_sender = sender;
+}
+
+bool enabled() {
+  return rate_limiting_enabled;
+}
+
+void shutdown() {
+  Summaries& s = summaries();
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.stopped = true;
+    s.wakeup.notify_one();
+  }
+  if (s.reporter.joinable())
+    s.reporter.join();
+
+  // Pending summaries, whatever the end of their window.
+  summarize(UINT64_MAX);
+}
+
+bool allow(const char* msg, std::size_t len) {
+  if (!rate_limiting_enabled)
+    return true;
+
+  const std::uint64_t h = hash(msg, len);
+  DedupSlot& slot = dedup.slots[h % dedup_slots];
+  if (slot.hash != h) {
+    forget(slot.bucket);
+    slot.hash = h;
+    slot.bucket.len = len < dedup_text ? len : dedup_text;
+    std::memcpy(slot.text, msg, slot.bucket.len);
+    slot.bucket.reset();
+  }
+
+  const std::uint64_t now = now_ns();
+  if (slot.bucket.take(now))
+    return true;
+  suppress(slot.bucket, now);
+  return false;
+}
+
+LiteralMessageContext* wrap(LiteralMessageContext* ctx, const char* msg) {
+  if (!rate_limiting_enabled || ctx == nullptr)
+    return ctx;
+  return new RateLimitedLiteralMessageContext(ctx, msg);
+}
+
+FormattedMessageContext* wrap(FormattedMessageContext* ctx, const char* fmt) {
+  if (!rate_limiting_enabled || ctx == nullptr)
+    return ctx;
+  return new RateLimitedFormattedMessageContext(ctx, fmt);
+}
+
+} // namespace rate_limiting
+} // namespace instrmt
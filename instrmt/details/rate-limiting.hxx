@@ -0,0 +1,37 @@
+#ifndef INSTRMTRATELIMITING_HXX
+#define INSTRMTRATELIMITING_HXX
+
+#include <instrmt/details/base.hxx>
+#include <instrmt/details/engine.hxx>
+
+#include <cstddef>
+
+namespace instrmt {
+namespace rate_limiting {
+
+// Enables message rate limiting: each literal or formatted message site, and
+// each distinct dynamic message, may emit `rate` messages per second (with
+// bursts of up to `rate` messages, at least 1). Suppressed messages are
+// summarized through `sender` by a background thread, at the end of each
+// one-second window.
+void enable(double rate, DynamicMessageSender* sender);
+
+bool enabled();
+
+// Sends the pending summaries and stops the background thread, must be
+// called before the engine is destroyed. Messages suppressed later are not
+// summarized.
+void shutdown();
+
+// Returns false if a dynamic message must be suppressed.
+bool allow(const char* msg, std::size_t len);
+
+// Wraps contexts created by the engine so they are rate limited.
+// Take ownership of ctx.
+LiteralMessageContext* wrap(LiteralMessageContext* ctx, const char* msg);
+FormattedMessageContext* wrap(FormattedMessageContext* ctx, const char* fmt);
+
+} // namespace rate_limiting
+} // namespace instrmt
+
+#endif // INSTRMTRATELIMITING_HXX
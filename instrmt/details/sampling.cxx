@@ -0,0 +1,222 @@
+#include "sampling.hxx"
+
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+namespace {
+
+bool sampling_enabled = false;
+std::uint64_t sampling_threshold = std::numeric_limits<std::uint64_t>::max();
+
+// Region of a discarded tree, allocated in per-thread slots instead of the
+// heap. Regions opened by INSTRMT_NAMED_REGION_BEGIN/END may overlap without
+// nesting, so the free slots are tracked by a bitmap rather than by depth.
+class DiscardedRegion final : public instrmt::Region {
+public:
+  ~DiscardedRegion();
+
+  static void* operator new(std::size_t size);
+  static void operator delete(void* ptr) noexcept;
+};
+
+constexpr unsigned int discarded_slots = 64; // Bits of ThreadState::busy.
+
+struct ThreadState {
+  std::uint64_t rng;
+  unsigned int depth = 0;
+  bool sampled = true;
+  std::uint64_t busy = 0; // Slots of discarded, one bit per slot.
+  typedef std::aligned_storage<sizeof(DiscardedRegion), alignof(DiscardedRegion)>::type Slot;
+  Slot discarded[discarded_slots];
+
+  ThreadState()
+    : rng(std::hash<std::thread::id>()(std::this_thread::get_id())
+          ^ static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()))
+  {
+    if (rng == 0)
+      rng = 0x9E3779B97F4A7C15ull;
+  }
+
+  // xorshift64*, good enough to pick one tree out of N.
+  std::uint64_t next() {
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return rng * 0x2545F4914F6CDD1Dull;
+  }
+};
+
+thread_local ThreadState state;
+
+DiscardedRegion::~DiscardedRegion() {
+  --state.depth;
+}
+
+void* DiscardedRegion::operator new(std::size_t size) {
+  if (state.busy == ~std::uint64_t(0))
+    return ::operator new(size);
+  const int slot = __builtin_ctzll(~state.busy);
+  state.busy |= std::uint64_t(1) << slot;
+  return &state.discarded[slot];
+}
+
+void DiscardedRegion::operator delete(void* ptr) noexcept {
+  const std::less<const void*> before;
+  if (before(ptr, state.discarded) || !before(ptr, state.discarded + discarded_slots)) {
+    ::operator delete(ptr);
+    return;
+  }
+  const auto slot = static_cast<ThreadState::Slot*>(ptr) - state.discarded;
+  state.busy &= ~(std::uint64_t(1) << slot);
+}
+
+class SampledRegion : public instrmt::Region {
+private:
+  std::unique_ptr<instrmt::Region> region;
+
+public:
+  explicit SampledRegion(std::unique_ptr<instrmt::Region> region)
+    : instrmt::Region()
+    , region(std::move(region))
+  {}
+
+  ~SampledRegion() {
+    // The engine's region must end before the tree can be closed.
+    region.reset();
+    --state.depth;
+  }
+};
+
+class SampledRegionContext : public instrmt::RegionContext {
+private:
+  std::unique_ptr<instrmt::RegionContext> ctx;
+
+protected:
+  instrmt::Region* make_region_ptr() override {
+    if (state.depth++ == 0)
+      state.sampled = state.next() <= sampling_threshold;
+
+    if (!state.sampled)
+      return new DiscardedRegion();
+
+    return new SampledRegion(ctx->make_region());
+  }
+
+public:
+  explicit SampledRegionContext(instrmt::RegionContext* ctx)
+    : instrmt::RegionContext()
+    , ctx(ctx)
+  {}
+};
+
+class SampledLiteralMessageContext : public instrmt::LiteralMessageContext {
+private:
+  std::unique_ptr<instrmt::LiteralMessageContext> ctx;
+
+public:
+  explicit SampledLiteralMessageContext(instrmt::LiteralMessageContext* ctx)
+    : instrmt::LiteralMessageContext()
+    , ctx(ctx)
+  {}
+
+  void emit_message() const override {
+    if (!instrmt::sampling::discarded())
+      ctx->emit_message();
+  }
+};
+
+class SampledFormattedMessageContext : public instrmt::FormattedMessageContext {
+private:
+  std::unique_ptr<instrmt::FormattedMessageContext> ctx;
+
+public:
+  explicit SampledFormattedMessageContext(instrmt::FormattedMessageContext* ctx)
+    : instrmt::FormattedMessageContext()
+    , ctx(ctx)
+  {}
+
+  void emit_message(const void* args, std::size_t size) const override {
+    if (!instrmt::sampling::discarded())
+      ctx->emit_message(args, size);
+  }
+};
+
+} // anonymous namespace
+
+namespace instrmt {
+namespace sampling {
+
+double parse_rate(const char* rate) {
+  const std::string str(rate);
+  double value = 0.0;
+
+  try {
+    const auto slash = str.find('/');
+    std::size_t end = 0;
+    if (slash == std::string::npos) {
+      value = std::stod(str, &end);
+    } else {
+      if (std::stod(str.substr(0, slash)) != 1.0)
+        throw std::invalid_argument(str);
+      const std::string denominator = str.substr(slash + 1);
+      // std::stoul accepts (and wraps) negative values.
+      if (denominator.empty() || !std::isdigit(static_cast<unsigned char>(denominator[0])))
+        throw std::invalid_argument(str);
+      value = 1.0 / std::stoul(denominator, &end);
+      end += slash + 1;
+    }
+    if (end != str.size())
+      throw std::invalid_argument(str);
+  } catch (const std::logic_error&) {
+    throw std::runtime_error("invalid sampling rate: " + str);
+  }
+
+  if (!(value > 0.0 && value <= 1.0))
+    throw std::runtime_error("invalid sampling rate: " + str);
+
+  return value;
+}
+
+void enable(double rate) {
+  sampling_enabled = rate < 1.0;
+  sampling_threshold = rate < 1.0
+      ? static_cast<std::uint64_t>(rate * static_cast<double>(std::numeric_limits<std::uint64_t>::max()))
+      : std::numeric_limits<std::uint64_t>::max();
+}
+
+bool enabled() {
+  return sampling_enabled;
+}
+
+bool discarded() {
+  return sampling_enabled && state.depth > 0 && !state.sampled;
+}
+
+RegionContext* wrap(RegionContext* ctx) {
+  if (!sampling_enabled || ctx == nullptr)
+    return ctx;
+  return new SampledRegionContext(ctx);
+}
+
+LiteralMessageContext* wrap(LiteralMessageContext* ctx) {
+  if (!sampling_enabled || ctx == nullptr)
+    return ctx;
+  return new SampledLiteralMessageContext(ctx);
+}
+
+FormattedMessageContext* wrap(FormattedMessageContext* ctx) {
+  if (!sampling_enabled || ctx == nullptr)
+    return ctx;
+  return new SampledFormattedMessageContext(ctx);
+}
+
+} // namespace sampling
+} // namespace instrmt
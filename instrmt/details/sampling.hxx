@@ -0,0 +1,32 @@
+#ifndef INSTRMTSAMPLING_HXX
+#define INSTRMTSAMPLING_HXX
+
+#include <instrmt/details/base.hxx>
+
+namespace instrmt {
+namespace sampling {
+
+// Parses a sampling rate, either as "1/N" or as a ratio in ]0, 1].
+// Throws std::runtime_error if the rate is invalid.
+double parse_rate(const char* rate);
+
+// Enables trace-level sampling: the decision to record a region is taken
+// when the outermost region of a thread is opened, and inherited by all the
+// regions and messages nested in it.
+void enable(double rate);
+
+bool enabled();
+
+// Returns true if the current thread is inside a region tree that was not sampled.
+bool discarded();
+
+// Wraps contexts created by the engine so they honor the sampling decision.
+// Take ownership of ctx.
+RegionContext* wrap(RegionContext* ctx);
+LiteralMessageContext* wrap(LiteralMessageContext* ctx);
+FormattedMessageContext* wrap(FormattedMessageContext* ctx);
+
+} // namespace sampling
+} // namespace instrmt
+
+#endif // INSTRMTSAMPLING_HXX
@@ -0,0 +1,119 @@
+#ifndef INSTRMTSCOPEDREGION_HXX
+#define INSTRMTSCOPEDREGION_HXX
+
+// C++20 alternative to the region macros:
+//
+//   void f() {
+//     instrmt::scoped_function fn;          // INSTRMT_FUNCTION()
+//     instrmt::scoped_region<"init"> init;  // INSTRMT_REGION("init")
+//     ...
+//     init.reset();                         // INSTRMT_REGION_END()
+//   }
+//
+// Each declaration is a distinct site: the unnamed template parameter is a
+// different closure type for every use of the template. The site is a static
+// of the instantiation, built with its id from the std::source_location of
+// the declaration when it is first entered. std::source_location cannot be a
+// template argument, and the default template arguments would be evaluated
+// where the template is declared, so the site cannot be constant-initialized
+// like the ones of the macros.
+//
+// Only available with the dynamic wrapper (and no-op with INSTRMT_DISABLE).
+
+#include <cstddef>
+#include <source_location>
+
+namespace instrmt {
+
+// String literal usable as a template argument.
+template<std::size_t N>
+struct fixed_string {
+  char data[N];
+
+  constexpr fixed_string(const char (&s)[N]) {
+    for (std::size_t i = 0; i < N; ++i)
+      data[i] = s[i];
+  }
+};
+
+#if defined(INSTRMT_DISABLE)
+
+template<fixed_string Name, auto = []{}>
+class scoped_region {
+public:
+  scoped_region() {}
+  void reset() {}
+};
+
+template<auto = []{}>
+class scoped_function {
+public:
+  scoped_function() {}
+  void reset() {}
+};
+
+#elif defined(INSTRMT_CXX_WRAPPER)
+
+template<fixed_string Name, auto Unique = []{}>
+class scoped_region {
+  static_assert(sizeof(Unique) == 0, "instrmt::scoped_region requires the dynamic wrapper");
+};
+
+template<auto Unique = []{}>
+class scoped_function {
+  static_assert(sizeof(Unique) == 0, "instrmt::scoped_function requires the dynamic wrapper");
+};
+
+#else
+
+namespace details {
+
+inline RegionSite make_region_site(const char* name, const std::source_location& location) {
+  const int line = static_cast<int>(location.line());
+  return {name, location.function_name(), location.file_name(), line,
+          site_id(name, location.function_name(), location.file_name(), line), {nullptr}};
+}
+
+} // namespace details
+
+template<fixed_string Name, auto = []{}>
+class scoped_region {
+private:
+  ScopedRegion region;
+
+  static RegionSite& site(const std::source_location& location) {
+    static RegionSite site = details::make_region_site(Name.data, location);
+    return site;
+  }
+
+public:
+  explicit scoped_region(std::source_location location = std::source_location::current())
+    : region(site(location))
+  {}
+
+  void reset() { region.reset(); }
+};
+
+template<auto = []{}>
+class scoped_function {
+private:
+  ScopedRegion region;
+
+  static RegionSite& site(const std::source_location& location) {
+    static RegionSite site = details::make_region_site(nullptr, location);
+    return site;
+  }
+
+public:
+  explicit scoped_function(std::source_location location = std::source_location::current())
+    : region(site(location))
+  {}
+
+  void reset() { region.reset(); }
+};
+
+#endif
+
+} // namespace instrmt
+
+#endif // INSTRMTSCOPEDREGION_HXX
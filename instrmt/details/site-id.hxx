@@ -0,0 +1,48 @@
+#ifndef INSTRMTSITEID_HXX
+#define INSTRMTSITEID_HXX
+
+#include <cstdint>
+
+namespace instrmt {
+
+namespace details {
+
+constexpr std::uint64_t fnv_offset_basis = 14695981039346656037ull;
+constexpr std::uint64_t fnv_prime = 1099511628211ull;
+
+constexpr std::uint64_t fnv1a(std::uint64_t hash, const char* p) {
+  if (p != nullptr) {
+    while (*p != '\0')
+      hash = (hash ^ static_cast<unsigned char>(*p++)) * fnv_prime;
+  }
+  // Separates the fields.
+  return (hash ^ 0xFF) * fnv_prime;
+}
+
+constexpr std::uint64_t fnv1a_line(std::uint64_t hash, int line) {
+  for (int i = 0; i < 4; ++i)
+    hash = (hash ^ ((static_cast<std::uint32_t>(line) >> (8 * i)) & 0xFF)) * fnv_prime;
+  return hash;
+}
+
+} // namespace details
+
+// 64-bit FNV-1a hash of the name, file and line of a site, computed at compile
+// time by the macros. It identifies a site across runs, as long as the
+// instrumented code does not move.
+constexpr std::uint64_t site_id(const char* name, const char* file, int line) {
+  return details::fnv1a_line(details::fnv1a(details::fnv1a(details::fnv_offset_basis, name), file), line);
+}
+
+// Same, for regions, which also hash their function: the function is the
+// name of the unnamed regions (INSTRMT_FUNCTION(), scoped_function), and tells
+// apart the instantiations of a template. The macros and scoped_region hash the
+// fields of the RegionSite, the function is __PRETTY_FUNCTION__ with
+// INSTRMT_QUALIFIED_FUNCTION_NAMES.
+constexpr std::uint64_t site_id(const char* name, const char* function, const char* file, int line) {
+  return details::fnv1a_line(details::fnv1a(details::fnv1a(details::fnv1a(details::fnv_offset_basis, name), function), file), line);
+}
+
+} // namespace instrmt
+
+#endif // INSTRMTSITEID_HXX
@@ -0,0 +1,209 @@
+#include "throttling.hxx"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include <instrmt/details/utils.hxx>
+
+using instrmt::ansi::style;
+
+namespace {
+
+// A site is re-evaluated at the end of each window: after that many calls, or
+// after window_ns, whichever comes first.
+constexpr std::uint64_t window_calls = 1024;
+constexpr std::uint64_t window_ns = 1000000000;
+
+// One call in measure_interval is timed, in every mode.
+constexpr std::uint64_t measure_interval = 16;
+
+// Sites called less often than that are never throttled.
+constexpr double min_calls_per_second = 1000.0;
+
+// Sites that would have to be throttled more than that are turned off.
+constexpr std::uint64_t max_interval = 1024;
+
+bool throttling_enabled = false;
+double throttling_budget = 0.0;
+
+std::uint64_t now_ns() {
+  return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+enum class Mode { record, throttle, off };
+
+class ThrottledRegionContext : public instrmt::RegionContext {
+private:
+  std::unique_ptr<instrmt::RegionContext> ctx;
+  std::string name;
+  std::atomic<Mode> mode{Mode::record};
+  std::atomic<std::uint64_t> interval{1};
+  std::atomic<std::uint64_t> counter{0};
+
+  // Current window.
+  std::atomic<std::uint64_t> window_start;
+  std::atomic<std::uint64_t> calls{0};
+  std::atomic<std::uint64_t> body_samples{0};
+  std::atomic<std::uint64_t> body_ns{0};
+  std::atomic<std::uint64_t> cost_samples{0};
+  std::atomic<std::uint64_t> cost_ns{0};
+  std::atomic<bool> evaluating{false};
+
+  // Cost of the instrumentation, kept from the last window in which calls
+  // were recorded (calls that are not recorded cannot measure it).
+  double mean_cost = 0.0;
+
+  // Times the body of a call, and the cost of the engine's region if the call
+  // is recorded.
+  class MeasuredRegion : public instrmt::Region {
+  private:
+    ThrottledRegionContext& owner;
+    std::uint64_t begin;
+    std::unique_ptr<instrmt::Region> region;
+    std::uint64_t begun;
+
+  public:
+    MeasuredRegion(ThrottledRegionContext& owner, bool record)
+      : instrmt::Region()
+      , owner(owner)
+      , begin(now_ns())
+      , region(record ? owner.ctx->make_region() : nullptr)
+      , begun(now_ns())
+    {}
+
+    ~MeasuredRegion() {
+      const std::uint64_t end = now_ns();
+      const bool recorded = region != nullptr;
+      region.reset();
+      const std::uint64_t ended = now_ns();
+      owner.report(end - begun, recorded, (begun - begin) + (ended - end), ended);
+    }
+  };
+
+  void report(std::uint64_t body, bool recorded, std::uint64_t cost, std::uint64_t now) {
+    body_ns.fetch_add(body, std::memory_order_relaxed);
+    body_samples.fetch_add(1, std::memory_order_relaxed);
+    if (recorded) {
+      cost_ns.fetch_add(cost, std::memory_order_relaxed);
+      cost_samples.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const std::uint64_t start = window_start.load(std::memory_order_relaxed);
+    if (calls.load(std::memory_order_relaxed) < window_calls && (now <= start || now - start < window_ns))
+      return;
+
+    // A single thread evaluates the window, the others keep going.
+    if (!evaluating.exchange(true, std::memory_order_acquire)) {
+      evaluate(now);
+      evaluating.store(false, std::memory_order_release);
+    }
+  }
+
+  // Concurrent calls may be counted in either window, this is only a
+  // statistic.
+  void evaluate(std::uint64_t now) {
+    // The window may have just been evaluated by another thread, after this
+    // call ended: it can start after now, and have no timed call yet.
+    const std::uint64_t start = window_start.load(std::memory_order_relaxed);
+    if (now <= start || body_samples.load(std::memory_order_relaxed) == 0)
+      return;
+
+    window_start.store(now, std::memory_order_relaxed);
+    const double elapsed_s = static_cast<double>(now - start) * 1e-9;
+    const double rate = static_cast<double>(calls.exchange(0, std::memory_order_relaxed)) / elapsed_s;
+    const double mean_body = static_cast<double>(body_ns.exchange(0, std::memory_order_relaxed))
+                           / static_cast<double>(body_samples.exchange(0, std::memory_order_relaxed));
+    const std::uint64_t costs = cost_samples.exchange(0, std::memory_order_relaxed);
+    const std::uint64_t cost_sum = cost_ns.exchange(0, std::memory_order_relaxed);
+    if (costs > 0)
+      mean_cost = static_cast<double>(cost_sum) / static_cast<double>(costs);
+
+    const Mode previous = mode.load(std::memory_order_relaxed);
+    const std::uint64_t previous_interval = interval.load(std::memory_order_relaxed);
+
+    if (rate < min_calls_per_second || mean_body >= throttling_budget * mean_cost) {
+      mode.store(Mode::record, std::memory_order_release);
+      if (previous != Mode::record)
+        std::cerr << style::yellow_fg << "[INSTRMT] Recording region " << name << " again"
+                  << " (" << mean_body << " ns per call, " << static_cast<std::uint64_t>(rate) << " calls/s)"
+                  << style::reset << std::endl;
+      return;
+    }
+
+    const double ratio = mean_body > 0.0 ? throttling_budget * mean_cost / mean_body : INFINITY;
+    if (ratio > max_interval) {
+      mode.store(Mode::off, std::memory_order_release);
+      if (previous != Mode::off)
+        std::cerr << style::yellow_fg << "[INSTRMT] Turning off region " << name
+                  << " (" << mean_body << " ns per call, " << mean_cost << " ns of overhead, "
+                  << static_cast<std::uint64_t>(rate) << " calls/s)" << style::reset << std::endl;
+    } else {
+      const std::uint64_t n = static_cast<std::uint64_t>(std::ceil(ratio));
+      interval.store(n, std::memory_order_relaxed);
+      mode.store(Mode::throttle, std::memory_order_release);
+      // The interval changes a little from a window to the next.
+      if (previous != Mode::throttle || n >= 2 * previous_interval || 2 * n <= previous_interval)
+        std::cerr << style::yellow_fg << "[INSTRMT] Throttling region " << name << " to 1 call in " << n
+                  << " (" << mean_body << " ns per call, " << mean_cost << " ns of overhead, "
+                  << static_cast<std::uint64_t>(rate) << " calls/s)" << style::reset << std::endl;
+    }
+  }
+
+protected:
+  instrmt::Region* make_region_ptr() override {
+    const std::uint64_t call = calls.fetch_add(1, std::memory_order_relaxed);
+
+    bool record = true;
+    switch (mode.load(std::memory_order_acquire)) {
+    case Mode::record:
+      break;
+    case Mode::off:
+      record = false;
+      break;
+    case Mode::throttle:
+      record = counter.fetch_add(1, std::memory_order_relaxed) % interval.load(std::memory_order_relaxed) == 0;
+      break;
+    }
+
+    if (call % measure_interval == 0)
+      return new MeasuredRegion(*this, record);
+
+    return record ? ctx->make_region().release() : nullptr;
+  }
+
+public:
+  ThrottledRegionContext(instrmt::RegionContext* ctx, const char* name)
+    : instrmt::RegionContext()
+    , ctx(ctx)
+    , name(name ? name : "")
+    , window_start(now_ns())
+  {}
+};
+
+} // anonymous namespace
+
+namespace instrmt {
+namespace throttling {
+
+void enable(double budget) {
+  throttling_enabled = budget > 0.0;
+  throttling_budget = budget;
+}
+
+bool enabled() {
+  return throttling_enabled;
+}
+
+RegionContext* wrap(RegionContext* ctx, const char* name) {
+  if (!throttling_enabled || ctx == nullptr)
+    return ctx;
+  return new ThrottledRegionContext(ctx, name);
+}
+
+} // namespace throttling
+} // namespace instrmt
@@ -0,0 +1,24 @@
+#ifndef INSTRMTTHROTTLING_HXX
+#define INSTRMTTHROTTLING_HXX
+
+#include <instrmt/details/base.hxx>
+
+namespace instrmt {
+namespace throttling {
+
+// Enables adaptive throttling: a sample of the calls of each region is
+// measured, and at the end of each window sites whose mean duration is lower
+// than `budget` times the cost of their instrumentation are throttled to 1
+// call in N, or turned off, and the others are recorded again.
+void enable(double budget);
+
+bool enabled();
+
+// Wraps a context created by the engine so it is throttled when necessary.
+// Take ownership of ctx.
+RegionContext* wrap(RegionContext* ctx, const char* name);
+
+} // namespace throttling
+} // namespace instrmt
+
+#endif // INSTRMTTHROTTLING_HXX
@@ -0,0 +1,170 @@
+#ifndef INSTRMTTRACEFORMAT_HXX
+#define INSTRMTTRACEFORMAT_HXX
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <time.h>
+
+// Binary records shared by the engines that do not format their output
+// (shm, trace, ...) and the tools that read it (instrmt-tail, ...).
+//
+// A trace file is a FileHeader followed by a sequence of blocks. Each block is
+// a BlockHeader followed by `capacity` items, of which only the first `count`
+// are valid. Site blocks define the sites referenced by the events of the
+// event blocks, they can appear anywhere in the file.
+
+namespace instrmt {
+namespace trace {
+
+constexpr char file_magic[8] = {'I', 'N', 'S', 'T', 'R', 'M', 'T', '\0'};
+constexpr std::uint32_t file_version = 4;
+
+enum class EventKind : std::uint16_t {
+  region = 1,
+  literal_message = 2,
+  message = 3,
+  formatted_message = 4,
+  continuation = 5       // Next part of the text of the previous message.
+};
+
+struct Event {
+  std::uint64_t time;      // CLOCK_MONOTONIC, in ns. Start of the region for regions.
+  std::uint64_t duration;  // In ns, regions only.
+  std::uint32_t site;      // Index of the site, regions and literal messages only.
+  std::uint32_t tid;
+  std::uint16_t kind;      // EventKind
+  std::uint16_t depth;     // Number of regions the event is nested in.
+  std::uint16_t size;      // Length of the text. Continuations: length of their part.
+  std::uint16_t reserved;
+  char text[32];           // Dynamic messages: not NUL terminated. Formatted messages: captured arguments.
+};
+
+static_assert(sizeof(Event) == 64, "Events must fit in a cache line");
+
+// Texts longer than Event::text continue in the events immediately following
+// the message, which are published along with it. Texts longer than
+// max_text_size are truncated, the size of the message is left untouched so
+// that readers can tell.
+constexpr std::size_t max_text_events = 32;
+constexpr std::size_t max_text_size = max_text_events * sizeof(Event::text);
+
+struct Site {
+  std::uint32_t line;
+  std::uint32_t reserved;
+  std::uint64_t id;        // site_id() of the site, stable across runs.
+  char name[104];          // NUL terminated, possibly truncated. Format string of formatted messages.
+  char types[8];           // Formatted messages only: format::Signature, NUL terminated if shorter.
+  char file[128];          // NUL terminated, possibly truncated.
+};
+
+static_assert(sizeof(Site) == 256, "Unexpected padding in Site");
+
+enum class BlockType : std::uint32_t {
+  sites = 1,
+  events = 2
+};
+
+struct FileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t pid;
+  std::int64_t clock_offset; // CLOCK_REALTIME - CLOCK_MONOTONIC, in ns.
+  std::uint64_t reserved;
+};
+
+static_assert(sizeof(FileHeader) == 32, "Unexpected padding in FileHeader");
+
+struct BlockHeader {
+  std::uint32_t type;      // BlockType
+  std::uint32_t item_size; // sizeof(Site) or sizeof(Event)
+  std::uint64_t capacity;
+  std::atomic<std::uint64_t> count;
+  std::uint64_t first;     // Sites: index of the first site of the block.
+};
+
+static_assert(sizeof(BlockHeader) == 32, "Unexpected padding in BlockHeader");
+
+inline std::uint64_t monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+inline std::int64_t clock_offset() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  const std::int64_t realtime = static_cast<std::int64_t>(ts.tv_sec) * 1000000000ll + ts.tv_nsec;
+  return realtime - static_cast<std::int64_t>(monotonic_ns());
+}
+
+inline void copy_string(char* dst, std::size_t size, const char* src) {
+  if (src == nullptr)
+    src = "";
+  std::size_t len = std::strlen(src);
+  if (len >= size)
+    len = size - 1;
+  std::memcpy(dst, src, len);
+  dst[len] = '\0';
+}
+
+// Copies the signature of a formatted message. A signature of 8 arguments
+// fills Site::types and is intentionally left without a terminating NUL.
+inline void copy_types(char (&dst)[8], const char* src) {
+  const std::size_t len = strnlen(src, sizeof(dst));
+  std::memcpy(dst, src, len);
+  std::memset(dst + len, 0, sizeof(dst) - len);
+}
+
+// Number of events used to store a text of `size` bytes, when at most `limit`
+// events fit in the buffer of the thread.
+inline std::size_t text_events(std::size_t size, std::size_t limit) {
+  std::size_t count = (size + sizeof(Event::text) - 1) / sizeof(Event::text);
+  if (count > max_text_events)
+    count = max_text_events;
+  if (count > limit)
+    count = limit;
+  return count > 0 ? count : 1;
+}
+
+// Stores a text in the `count` events of a message. `slot(i)` returns the i-th
+// event, the first one must already be filled, but for its text.
+template<typename Slot>
+void store_text(const Slot& slot, std::size_t count, const void* text, std::size_t size) {
+  Event& message = *slot(0);
+  message.size = static_cast<std::uint16_t>(size < 0xFFFF ? size : 0xFFFF);
+
+  const char* data = static_cast<const char*>(text);
+  for (std::size_t i = 0; i < count && size > 0; ++i) {
+    Event& event = *slot(i);
+    if (i > 0)
+      event = message;
+
+    const std::size_t part = size < sizeof(event.text) ? size : sizeof(event.text);
+    std::memcpy(event.text, data, part);
+    if (i > 0) {
+      event.kind = static_cast<std::uint16_t>(EventKind::continuation);
+      event.size = static_cast<std::uint16_t>(part);
+    }
+    data += part;
+    size -= part;
+  }
+}
+
+// Reassembles the text of a message whose continuations are within [message + 1, end).
+// Returns false if the text was truncated.
+inline bool load_text(const Event* message, const Event* end, std::string& text) {
+  text.assign(message->text, message->size < sizeof(message->text) ? message->size : sizeof(message->text));
+  for (const Event* event = message + 1;
+       event != end && text.size() < message->size && event->kind == static_cast<std::uint16_t>(EventKind::continuation);
+       ++event)
+    text.append(event->text, event->size < sizeof(event->text) ? event->size : sizeof(event->text));
+  return text.size() == message->size;
+}
+
+} // namespace trace
+} // namespace instrmt
+
+#endif // INSTRMTTRACEFORMAT_HXX
@@ -4,4 +4,7 @@
 #define INSTRMTCONCATIMPL(x,y) x##y
 #define INSTRMTCONCAT(x,y) INSTRMTCONCATIMPL(x,y)
 
+#define INSTRMTFIRSTARGIMPL(x, ...) x
+#define INSTRMTFIRSTARG(...) INSTRMTFIRSTARGIMPL(__VA_ARGS__, 0)
+
 #endif // INSTRMTUTILS_H
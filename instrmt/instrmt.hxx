@@ -1,8 +1,12 @@
 #ifndef INSTRMT_HXX
 #define INSTRMT_HXX
 
+#include <instrmt/details/level.h>
+
 #ifndef INSTRMT_DISABLE
 
+#include <instrmt/details/function-name.hxx>
+
 #ifdef INSTRMT_CXX_WRAPPER
 #include INSTRMT_CXX_WRAPPER
 #else
@@ -11,9 +15,9 @@
 #include <instrmt/details/utils.h>
 
 #define INSTRMT_NAMED_REGION(VAR, NAME) \
-  static const std::unique_ptr<::instrmt::RegionContext> INSTRMTCONCAT(VAR, _instrmt_region_ctx) = \
-    ::instrmt::make_region_context(NAME, __FUNCTION__, __FILE__, __LINE__); \
-  std::unique_ptr<::instrmt::Region> INSTRMTCONCAT(VAR, _instrmt_region) = INSTRMTCONCAT(VAR, _instrmt_region_ctx) ? INSTRMTCONCAT(VAR, _instrmt_region_ctx)->make_region() : nullptr
+  static ::instrmt::RegionSite INSTRMTCONCAT(VAR, _instrmt_region_site) = {NAME, INSTRMTSITEFUNCTION, __FILE__, __LINE__, \
+    ::instrmt::site_id(NAME, INSTRMTSITEFUNCTION, __FILE__, __LINE__), {nullptr}}; \
+  ::instrmt::ScopedRegion INSTRMTCONCAT(VAR, _instrmt_region)(INSTRMTCONCAT(VAR, _instrmt_region_site))
 
 #define INSTRMT_NAMED_REGION_BEGIN(VAR, NAME) \
   INSTRMT_NAMED_REGION(VAR, NAME)
@@ -30,13 +34,17 @@
 #define INSTRMT_REGION_END()\
   INSTRMT_NAMED_REGION_END(_)
 
+#ifdef INSTRMT_QUALIFIED_FUNCTION_NAMES
+#define INSTRMT_FUNCTION() \
+  INSTRMT_QUALIFIED_FUNCTION()
+#else
 #define INSTRMT_FUNCTION() \
   INSTRMT_NAMED_REGION(_, nullptr)
+#endif
 
 #define INSTRMT_NAMED_LITERAL_MESSAGE(VAR, MSG) \
-  static const std::unique_ptr<::instrmt::LiteralMessageContext> INSTRMTCONCAT(VAR, _instrmt_msg_ctx) = \
-    ::instrmt::make_literal_message_context(MSG); \
-  if (INSTRMTCONCAT(VAR, _instrmt_msg_ctx)) INSTRMTCONCAT(VAR, _instrmt_msg_ctx)->emit_message()
+  static ::instrmt::LiteralMessageSite INSTRMTCONCAT(VAR, _instrmt_msg_site) = {MSG, ::instrmt::site_id(MSG, __FILE__, __LINE__), {nullptr}}; \
+  ::instrmt::emit_literal_message(INSTRMTCONCAT(VAR, _instrmt_msg_site))
 
 #define INSTRMT_LITERAL_MESSAGE(MSG) \
   INSTRMT_NAMED_LITERAL_MESSAGE(_, MSG)
@@ -44,8 +52,32 @@
 #define INSTRMT_MESSAGE(MSG) \
   ::instrmt::emit_message(MSG)
 
+#define INSTRMT_MESSAGE_N(MSG, LEN) \
+  ::instrmt::emit_message(MSG, LEN)
+
+#define INSTRMT_NAMED_MESSAGEF(VAR, ...) \
+  static ::instrmt::FormattedMessageSite INSTRMTCONCAT(VAR, _instrmt_fmt_site) = {INSTRMTFIRSTARG(__VA_ARGS__), \
+    decltype(::instrmt::format::check(__VA_ARGS__), ::instrmt::format::signature(__VA_ARGS__))::types, __FILE__, __LINE__, \
+    ::instrmt::site_id(INSTRMTFIRSTARG(__VA_ARGS__), __FILE__, __LINE__), {nullptr}}; \
+  ::instrmt::emit_formatted_message(INSTRMTCONCAT(VAR, _instrmt_fmt_site), __VA_ARGS__)
+
+#define INSTRMT_MESSAGEF(...) \
+  INSTRMT_NAMED_MESSAGEF(_, __VA_ARGS__)
+
 #endif // INSTRMT_CXX_WRAPPER
 
+#define INSTRMT_LEVELED_MESSAGE(LEVEL, MSG) \
+  do { \
+    static const bool _instrmt_level_enabled = instrmt_level_enabled(LEVEL); \
+    if (_instrmt_level_enabled) { INSTRMT_MESSAGE(MSG); } \
+  } while (0)
+
+#define INSTRMT_LEVELED_LITERAL_MESSAGE(LEVEL, MSG) \
+  do { \
+    static const bool _instrmt_level_enabled = instrmt_level_enabled(LEVEL); \
+    if (_instrmt_level_enabled) { INSTRMT_LITERAL_MESSAGE(MSG); } \
+  } while (0)
+
 #else // INSTRMT_DISABLE
 
 #define INSTRMT_NAMED_REGION(VAR, NAME)
@@ -68,6 +100,44 @@
 
 #define INSTRMT_MESSAGE(MSG)
 
+#define INSTRMT_MESSAGE_N(MSG, LEN)
+
+#define INSTRMT_NAMED_MESSAGEF(VAR, ...)
+
+#define INSTRMT_MESSAGEF(...)
+
+#define INSTRMT_LEVELED_MESSAGE(LEVEL, MSG)
+
+#define INSTRMT_LEVELED_LITERAL_MESSAGE(LEVEL, MSG)
+
 #endif // INSTRMT_DISABLE
 
+#if INSTRMT_MIN_LEVEL <= INSTRMT_LEVEL_DEBUG
+#define INSTRMT_MESSAGE_DEBUG(MSG) INSTRMT_LEVELED_MESSAGE(INSTRMT_LEVEL_DEBUG, MSG)
+#define INSTRMT_LITERAL_MESSAGE_DEBUG(MSG) INSTRMT_LEVELED_LITERAL_MESSAGE(INSTRMT_LEVEL_DEBUG, MSG)
+#else
+#define INSTRMT_MESSAGE_DEBUG(MSG)
+#define INSTRMT_LITERAL_MESSAGE_DEBUG(MSG)
+#endif
+
+#if INSTRMT_MIN_LEVEL <= INSTRMT_LEVEL_INFO
+#define INSTRMT_MESSAGE_INFO(MSG) INSTRMT_LEVELED_MESSAGE(INSTRMT_LEVEL_INFO, MSG)
+#define INSTRMT_LITERAL_MESSAGE_INFO(MSG) INSTRMT_LEVELED_LITERAL_MESSAGE(INSTRMT_LEVEL_INFO, MSG)
+#else
+#define INSTRMT_MESSAGE_INFO(MSG)
+#define INSTRMT_LITERAL_MESSAGE_INFO(MSG)
+#endif
+
+#if INSTRMT_MIN_LEVEL <= INSTRMT_LEVEL_WARN
+#define INSTRMT_MESSAGE_WARN(MSG) INSTRMT_LEVELED_MESSAGE(INSTRMT_LEVEL_WARN, MSG)
+#define INSTRMT_LITERAL_MESSAGE_WARN(MSG) INSTRMT_LEVELED_LITERAL_MESSAGE(INSTRMT_LEVEL_WARN, MSG)
+#else
+#define INSTRMT_MESSAGE_WARN(MSG)
+#define INSTRMT_LITERAL_MESSAGE_WARN(MSG)
+#endif
+
+#if __cplusplus >= 202002L
+#include <instrmt/details/scoped-region.hxx>
+#endif
+
 #endif // INSTRMT_HXX
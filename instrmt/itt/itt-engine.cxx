@@ -3,6 +3,8 @@
 
 #include <ittnotify.h>
 
+#include <string>
+
 namespace {
 static __itt_domain* instrmt_domain = __itt_domain_create("instrmt");
 }
@@ -68,19 +70,21 @@ public:
 instrmt::RegionContext* make_region_context(const char* name,
                                             const char* function,
                                             const char* /*file*/,
-                                            int /*line*/)
+                                            int /*line*/,
+                                            std::uint64_t /*id*/)
 {
   return new instrmt::itt::RegionContext(name ? name : function);
 }
 
-::instrmt::LiteralMessageContext* make_literal_message_context(const char* msg)
+::instrmt::LiteralMessageContext* make_literal_message_context(const char* msg, std::uint64_t /*id*/)
 {
   return new instrmt::itt::LiteralMessageContext(msg);
 }
 
-void instrmt_dynamic_message(const char* msg)
+void instrmt_dynamic_message(const char* msg, std::size_t len)
 {
-  __itt_marker(instrmt_domain, __itt_null, __itt_string_handle_create(msg), __itt_scope_global);
+  // ITT only accepts NUL terminated strings.
+  __itt_marker(instrmt_domain, __itt_null, __itt_string_handle_create(std::string(msg, len).c_str()), __itt_scope_global);
 }
 
 } // namespace itt
@@ -88,11 +92,12 @@ void instrmt_dynamic_message(const char* msg)
 
 extern "C" {
 
-instrmt::InstrmtEngine make_instrmt_engine() {
+instrmt::InstrmtEngine make_instrmt_engine_v2() {
   return {
     instrmt::itt::make_region_context,
     instrmt::itt::make_literal_message_context,
-    instrmt::itt::instrmt_dynamic_message
+    instrmt::itt::instrmt_dynamic_message,
+    nullptr // Formatted messages are formatted by the core.
   };
 }
 
@@ -0,0 +1,97 @@
+#ifndef INSTRMTITTPOLICY_HXX
+#define INSTRMTITTPOLICY_HXX
+
+#include <ittnotify.h>
+
+#include <string>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+static const __itt_domain* __itt_domain_name = __itt_domain_create("instrmt");
+
+class InstrmtITTRegion
+{
+private:
+  bool live = true;
+
+public:
+  inline explicit InstrmtITTRegion(__itt_string_handle* pName) {
+    __itt_task_begin(__itt_domain_name, __itt_null, __itt_null, pName);
+  }
+
+  inline void terminate() {
+    if (live) {
+      live = false;
+      __itt_task_end(__itt_domain_name);
+    }
+  }
+
+  inline ~InstrmtITTRegion() {
+    terminate();
+  }
+};
+
+inline void instrmt_itt_emit_message(const char* msg)
+{
+  __itt_marker(__itt_domain_name, __itt_null, __itt_string_handle_create(msg), __itt_scope_track_group);
+}
+
+// ITT only accepts NUL terminated strings.
+inline void instrmt_itt_emit_message(const char* msg, size_t len)
+{
+  instrmt_itt_emit_message(std::string(msg, len).c_str());
+}
+
+inline void instrmt_itt_emit_message(const std::string& msg)
+{
+  instrmt_itt_emit_message(msg.c_str());
+}
+
+#if __cplusplus >= 201703L
+inline void instrmt_itt_emit_message(std::string_view msg)
+{
+  instrmt_itt_emit_message(msg.data(), msg.size());
+}
+#endif
+
+namespace instrmt {
+
+// Policy of the ITT wrapper, see instrmt/details/compose.hxx.
+struct ITTPolicy {
+  struct Site {
+    __itt_string_handle* handle;
+
+    Site(const char* name, const char* /*function*/, const char* /*file*/, int /*line*/)
+      : handle(__itt_string_handle_create(name))
+    {}
+  };
+
+  class Region : public InstrmtITTRegion {
+  public:
+    explicit Region(const Site& site)
+      : InstrmtITTRegion(site.handle)
+    {}
+  };
+
+  struct LiteralMessageSite {
+    __itt_string_handle* handle;
+
+    explicit LiteralMessageSite(const char* msg)
+      : handle(__itt_string_handle_create(msg))
+    {}
+  };
+
+  static void emit_literal_message(const LiteralMessageSite& site) {
+    __itt_marker(__itt_domain_name, __itt_null, site.handle, __itt_scope_track_group);
+  }
+
+  static void emit_message(const char* msg, size_t len) {
+    instrmt_itt_emit_message(msg, len);
+  }
+};
+
+} // namespace instrmt
+
+#endif // INSTRMTITTPOLICY_HXX
@@ -1,34 +1,10 @@
 #ifndef INSTRMTITTWRAPPER_HXX
 #define INSTRMTITTWRAPPER_HXX
 
+#include <instrmt/itt/itt-policy.hxx>
+#include <instrmt/details/format.hxx>
 #include <instrmt/details/utils.h>
 
-#include <ittnotify.h>
-
-static const __itt_domain* __itt_domain_name = __itt_domain_create("instrmt");
-
-class InstrmtITTRegion
-{
-private:
-  bool live = true;
-
-public:
-  inline explicit InstrmtITTRegion(__itt_string_handle* pName) {
-    __itt_task_begin(__itt_domain_name, __itt_null, __itt_null, pName);
-  }
-
-  inline void terminate() {
-    if (live) {
-      live = false;
-      __itt_task_end(__itt_domain_name);
-    }
-  }
-
-  inline ~InstrmtITTRegion() {
-    terminate();
-  }
-};
-
 #define INSTRMT_NAMED_REGION(VAR, NAME) \
   static __itt_string_handle* INSTRMTCONCAT(VAR, _itt_region_name) = __itt_string_handle_create(NAME); \
   InstrmtITTRegion INSTRMTCONCAT(VAR, _itt_region) ( INSTRMTCONCAT(VAR, _itt_region_name) )
@@ -43,7 +19,11 @@ public:
 
 #define INSTRMT_REGION_END() INSTRMT_NAMED_REGION_END(_)
 
+#ifdef INSTRMT_QUALIFIED_FUNCTION_NAMES
+#define INSTRMT_FUNCTION() INSTRMT_QUALIFIED_FUNCTION()
+#else
 #define INSTRMT_FUNCTION() INSTRMT_NAMED_REGION(_, __FUNCTION__)
+#endif
 
 #define INSTRMT_NAMED_LITERAL_MESSAGE(VAR, MSG) \
   static __itt_string_handle* INSTRMTCONCAT(VAR, _itt_message) = __itt_string_handle_create(MSG); \
@@ -53,6 +33,16 @@ public:
   INSTRMT_NAMED_LITERAL_MESSAGE(_, MSG)
 
 #define INSTRMT_MESSAGE(MSG) \
-  __itt_marker(__itt_domain_name, __itt_null, __itt_string_handle_create(MSG), __itt_scope_track_group)
+  instrmt_itt_emit_message(MSG)
+
+// ITT only accepts NUL terminated strings.
+#define INSTRMT_MESSAGE_N(MSG, LEN) \
+  instrmt_itt_emit_message(MSG, LEN)
+
+#define INSTRMT_NAMED_MESSAGEF(VAR, ...) \
+  instrmt_itt_emit_message(::instrmt::format::now(__VA_ARGS__))
+
+#define INSTRMT_MESSAGEF(...) \
+  INSTRMT_NAMED_MESSAGEF(_, __VA_ARGS__)
 
 #endif // INSTRMTITTWRAPPER_HXX
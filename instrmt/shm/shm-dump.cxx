@@ -0,0 +1,144 @@
+#include "shm-dump.hxx"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+using instrmt::trace::BlockHeader;
+using instrmt::trace::BlockType;
+using instrmt::trace::Event;
+using instrmt::trace::Site;
+
+constexpr std::size_t sites_per_batch = 64;
+
+// Only used by dump(), which is never run concurrently (see shm-engine.cxx).
+Site site_batch[sites_per_batch];
+
+bool write_all(int fd, const void* data, std::size_t size) {
+  const char* p = static_cast<const char*>(data);
+  while (size > 0) {
+    const ssize_t written = write(fd, p, size);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    p += written;
+    size -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+bool write_block_header(int fd, BlockType type, std::uint32_t item_size, std::uint64_t count, std::uint64_t first) {
+  BlockHeader block{};
+  block.type = static_cast<std::uint32_t>(type);
+  block.item_size = item_size;
+  block.capacity = count;
+  block.count.store(count, std::memory_order_relaxed);
+  block.first = first;
+  return write_all(fd, &block, sizeof(block));
+}
+
+bool write_sites(const instrmt::shm::RingHeader* header, int fd) {
+  std::uint32_t count = header->site_count.load(std::memory_order_acquire);
+  if (count > header->max_sites)
+    count = header->max_sites;
+  if (count == 0)
+    return true;
+
+  if (!write_block_header(fd, BlockType::sites, sizeof(Site), count, 0))
+    return false;
+
+  // Sites that are still being registered are written empty.
+  const instrmt::shm::SiteSlot* slots = instrmt::shm::sites(header);
+  for (std::uint32_t first = 0; first < count; first += sites_per_batch) {
+    const std::uint32_t n = count - first < sites_per_batch ? count - first : sites_per_batch;
+    for (std::uint32_t i = 0; i < n; ++i) {
+      const instrmt::shm::SiteSlot& slot = slots[first + i];
+      if (slot.ready.load(std::memory_order_acquire))
+        site_batch[i] = slot.site;
+      else
+        std::memset(&site_batch[i], 0, sizeof(Site));
+    }
+    if (!write_all(fd, site_batch, n * sizeof(Site)))
+      return false;
+  }
+
+  return true;
+}
+
+// Events of a lane are stored in the order they ended, older events are skipped
+// until one ends after `cutoff`. The owner of the lane may keep writing while it
+// is dumped, so the oldest events can be torn if the lane wraps in the meantime.
+long long write_lane(const instrmt::shm::LaneHeader* lane, std::uint64_t capacity, int fd, std::uint64_t cutoff) {
+  const Event* events = instrmt::shm::events(lane);
+  const std::uint64_t head = lane->head.load(std::memory_order_acquire);
+
+  std::uint64_t first = head > capacity ? head - capacity : 0;
+  while (first < head) {
+    const Event& event = events[first & (capacity - 1)];
+    if (event.time + event.duration >= cutoff)
+      break;
+    ++first;
+  }
+
+  if (first == head)
+    return 0;
+
+  if (!write_block_header(fd, BlockType::events, sizeof(Event), head - first, 0))
+    return -1;
+
+  // The events are contiguous in the lane, unless they wrap around its end.
+  const std::uint64_t begin = first & (capacity - 1);
+  const std::uint64_t end = head & (capacity - 1);
+  if (begin < end || end == 0) {
+    if (!write_all(fd, &events[begin], (head - first) * sizeof(Event)))
+      return -1;
+  } else {
+    if (!write_all(fd, &events[begin], (capacity - begin) * sizeof(Event))
+        || !write_all(fd, &events[0], end * sizeof(Event)))
+      return -1;
+  }
+
+  return static_cast<long long>(head - first);
+}
+
+} // anonymous namespace
+
+namespace instrmt {
+namespace shm {
+
+long long dump(const RingHeader* header, int fd, std::uint64_t window) {
+  const std::uint64_t now = trace::monotonic_ns();
+  const std::uint64_t cutoff = window > 0 && now > window ? now - window : 0;
+
+  trace::FileHeader file;
+  std::memset(&file, 0, sizeof(file));
+  std::memcpy(file.magic, trace::file_magic, sizeof(file.magic));
+  file.version = trace::file_version;
+  file.pid = header->pid;
+  file.clock_offset = header->clock_offset;
+
+  if (!write_all(fd, &file, sizeof(file)) || !write_sites(header, fd))
+    return -1;
+
+  long long total = 0;
+  for (std::uint32_t i = 0; i < header->lane_count; ++i) {
+    const LaneHeader* l = lane(header, i);
+    if (l->head.load(std::memory_order_relaxed) == 0)
+      continue;
+
+    const long long written = write_lane(l, header->lane_capacity, fd, cutoff);
+    if (written < 0)
+      return -1;
+    total += written;
+  }
+
+  return total;
+}
+
+} // namespace shm
+} // namespace instrmt
@@ -0,0 +1,20 @@
+#ifndef INSTRMTSHMDUMP_HXX
+#define INSTRMTSHMDUMP_HXX
+
+#include <cstdint>
+
+#include "shm-ring.hxx"
+
+namespace instrmt {
+namespace shm {
+
+// Writes the sites and the events of a ring to fd, as a binary trace file.
+// Only the events that ended less than `window` ns ago are kept (0 keeps them all).
+// Returns the number of events written, or -1 if an error occurred.
+// Async-signal-safe: only uses write(), clock_gettime() and lock-free atomics.
+long long dump(const RingHeader* header, int fd, std::uint64_t window);
+
+} // namespace shm
+} // namespace instrmt
+
+#endif // INSTRMTSHMDUMP_HXX
@@ -0,0 +1,638 @@
+#include <instrmt/details/base.hxx>
+#include <instrmt/details/engine.hxx>
+#include <instrmt/details/trace-format.hxx>
+#include <instrmt/details/utils.hxx>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "shm-dump.hxx"
+#include "shm-ring.hxx"
+
+using instrmt::ansi::style;
+
+namespace {
+
+const char shm_lanes_env[] = "INSTRMT_SHM_LANES";
+const char shm_lane_size_env[] = "INSTRMT_SHM_LANE_SIZE";
+const char shm_max_sites_env[] = "INSTRMT_SHM_MAX_SITES";
+const char shm_dump_env[] = "INSTRMT_SHM_DUMP";
+const char shm_dump_window_env[] = "INSTRMT_SHM_DUMP_WINDOW";
+const char shm_dump_slow_env[] = "INSTRMT_SHM_DUMP_SLOW";
+const char shm_dump_on_crash_env[] = "INSTRMT_SHM_DUMP_ON_CRASH";
+
+constexpr std::uint32_t invalid_site = 0xFFFFFFFF;
+
+std::uint32_t parse_env(const char* e, std::uint32_t def) {
+  const char* value = getenv(e);
+  if (value == nullptr)
+    return def;
+
+  char* end = nullptr;
+  const unsigned long v = std::strtoul(value, &end, 10);
+  if (end == value || *end != '\0' || v == 0 || v > 0xFFFFFFFFul)
+    throw std::runtime_error(std::string("invalid value for ") + e + ": " + value);
+  return static_cast<std::uint32_t>(v);
+}
+
+class Segment {
+private:
+  std::string name;
+  std::size_t size = 0;
+
+public:
+  instrmt::shm::RingHeader* header = nullptr;
+
+  void create(std::uint32_t lane_count, std::uint32_t lane_capacity, std::uint32_t max_sites) {
+    name = instrmt::shm::segment_name(static_cast<unsigned long>(getpid()));
+    size = instrmt::shm::segment_size(max_sites, lane_count, lane_capacity);
+
+    const int fd = shm_open(name.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0600);
+    if (fd < 0)
+      throw std::runtime_error("unable to create " + name + " (" + std::strerror(errno) + ")");
+
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      const int err = errno;
+      close(fd);
+      shm_unlink(name.c_str());
+      throw std::runtime_error("unable to resize " + name + " (" + std::strerror(err) + ")");
+    }
+
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    const int err = errno;
+    close(fd);
+    if (addr == MAP_FAILED) {
+      shm_unlink(name.c_str());
+      throw std::runtime_error("unable to map " + name + " (" + std::strerror(err) + ")");
+    }
+
+    // The segment is zero-filled by ftruncate().
+    header = static_cast<instrmt::shm::RingHeader*>(addr);
+    header->version = instrmt::shm::ring_version;
+    header->pid = static_cast<std::uint32_t>(getpid());
+    header->lane_count = lane_count;
+    header->lane_capacity = lane_capacity;
+    header->max_sites = max_sites;
+    header->clock_offset = instrmt::trace::clock_offset();
+
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, instrmt::shm::ring_magic, sizeof(header->magic));
+  }
+
+  const std::string& path() const { return name; }
+
+  // Async-signal-safe, used when the process is about to die.
+  void unlink() {
+    if (header)
+      shm_unlink(name.c_str());
+  }
+
+  ~Segment() {
+    // Readers that are still attached keep their mapping.
+    if (header) {
+      munmap(header, size);
+      shm_unlink(name.c_str());
+    }
+  }
+};
+
+Segment segment;
+
+// Builds messages without allocating, for use in signal handlers.
+class Text {
+private:
+  char data[PATH_MAX + 128];
+  std::size_t size = 0;
+
+public:
+  Text& operator<<(const char* s) {
+    while (*s && size + 1 < sizeof(data))
+      data[size++] = *s++;
+    data[size] = '\0';
+    return *this;
+  }
+
+  Text& operator<<(unsigned long long v) {
+    char digits[20];
+    int n = 0;
+    do {
+      digits[n++] = static_cast<char>('0' + v % 10);
+      v /= 10;
+    } while (v > 0);
+    while (n > 0 && size + 1 < sizeof(data))
+      data[size++] = digits[--n];
+    data[size] = '\0';
+    return *this;
+  }
+
+  const char* c_str() const { return data; }
+
+  void write_to(int fd) const {
+    if (::write(fd, data, size) < 0) {} // Nothing left to do if stderr is gone.
+  }
+};
+
+const int crash_signals[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+
+// Dumps the lanes to a new file each time a trigger fires. SIGUSR1 and slow
+// regions wake up a background thread, so that the thread that triggered the
+// dump is not held while it is written. Concurrent triggers are ignored while
+// a dump is in progress. Crash dumps are written by the crashing thread, on
+// its alternate stack, to their own file even if another dump is in progress.
+class FlightRecorder {
+private:
+  char prefix[PATH_MAX];
+  std::uint64_t window = 0;
+  std::atomic<bool> dumping{false};
+  std::atomic<unsigned long long> dumps{0};
+  std::atomic<std::uint64_t> last_slow_dump{0};
+  struct sigaction previous[NSIG];
+
+  // Posted by the triggers (sem_post() is async-signal-safe).
+  sem_t wakeup;
+  std::atomic<const char*> pending{nullptr};
+  std::atomic<bool> stopping{false};
+  std::thread dumper;
+
+  static void on_dump_signal(int, siginfo_t*, void*);
+  static void on_crash_signal(int);
+
+  void run();
+
+  void write(const char* reason);
+
+  void request(const char* reason) {
+    pending.store(reason, std::memory_order_release);
+    sem_post(&wakeup);
+  }
+
+public:
+  bool enabled = false;
+  bool crash_dumps = false;
+  std::uint64_t slow_threshold = 0;
+
+  FlightRecorder() = default;
+  FlightRecorder(const FlightRecorder&) = delete;
+  FlightRecorder& operator=(const FlightRecorder&) = delete;
+  ~FlightRecorder();
+
+  void configure(const char* path, std::uint64_t window_ns, std::uint64_t slow_ns, bool on_crash);
+
+  void dump(const char* reason);
+
+  // Called with the duration of each region, when slow_threshold is set.
+  void on_slow_region(std::uint64_t end) {
+    // At most one dump per second, a burst of slow regions would otherwise
+    // keep the recorder busy dumping the same events.
+    std::uint64_t last = last_slow_dump.load(std::memory_order_relaxed);
+    if (last != 0 && end - last < 1000000000ull)
+      return;
+    if (last_slow_dump.compare_exchange_strong(last, end, std::memory_order_relaxed))
+      request("slow region");
+  }
+
+  void crash(int sig) {
+    write("crash");
+    segment.unlink();
+    sigaction(sig, &previous[sig], nullptr);
+    raise(sig);
+  }
+};
+
+FlightRecorder recorder;
+
+void FlightRecorder::on_dump_signal(int sig, siginfo_t* info, void* context) {
+  const int saved_errno = errno;
+  recorder.request("SIGUSR1");
+  errno = saved_errno;
+
+  // Chain to the handler of the application, if any.
+  const struct sigaction& chained = recorder.previous[sig];
+  if (chained.sa_flags & SA_SIGINFO)
+    chained.sa_sigaction(sig, info, context);
+  else if (chained.sa_handler != SIG_DFL && chained.sa_handler != SIG_IGN)
+    chained.sa_handler(sig);
+}
+
+FlightRecorder::~FlightRecorder() {
+  if (!dumper.joinable())
+    return;
+
+  // Pending dumps are written first.
+  stopping.store(true, std::memory_order_release);
+  sem_post(&wakeup);
+  dumper.join();
+  sem_destroy(&wakeup);
+}
+
+void FlightRecorder::run() {
+  for (;;) {
+    while (sem_wait(&wakeup) != 0 && errno == EINTR) {}
+
+    if (const char* reason = pending.exchange(nullptr, std::memory_order_acquire))
+      dump(reason);
+
+    if (stopping.load(std::memory_order_acquire))
+      return;
+  }
+}
+
+void FlightRecorder::on_crash_signal(int sig) {
+  recorder.crash(sig);
+}
+
+void FlightRecorder::configure(const char* path, std::uint64_t window_ns, std::uint64_t slow_ns, bool on_crash) {
+  if (std::strlen(path) + 24 > sizeof(prefix))
+    throw std::runtime_error(std::string("path too long for ") + shm_dump_env + ": " + path);
+
+  std::strcpy(prefix, path);
+  window = window_ns;
+  slow_threshold = slow_ns;
+  enabled = true;
+
+  if (sem_init(&wakeup, 0, 0) != 0)
+    throw std::runtime_error(std::string("unable to create the flight recorder (") + std::strerror(errno) + ")");
+  dumper = std::thread(&FlightRecorder::run, this);
+
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  sigemptyset(&action.sa_mask);
+  action.sa_sigaction = on_dump_signal;
+  action.sa_flags = SA_RESTART | SA_SIGINFO;
+  sigaction(SIGUSR1, &action, &previous[SIGUSR1]);
+
+  if (on_crash) {
+    crash_dumps = true;
+    action.sa_handler = on_crash_signal;
+    action.sa_flags = SA_ONSTACK;
+    for (int sig : crash_signals)
+      sigaction(sig, &action, &previous[sig]);
+  }
+}
+
+void FlightRecorder::dump(const char* reason) {
+  if (dumping.exchange(true, std::memory_order_acquire))
+    return;
+
+  write(reason);
+
+  dumping.store(false, std::memory_order_release);
+}
+
+void FlightRecorder::write(const char* reason) {
+  Text path;
+  path << prefix << "." << (dumps.fetch_add(1, std::memory_order_relaxed) + 1);
+
+  Text message;
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  const long long count = fd < 0 ? -1 : instrmt::shm::dump(segment.header, fd, window);
+  if (fd >= 0)
+    close(fd);
+
+  if (count < 0)
+    message << instrmt::ansi::escape_sequence(style::red_bg) << "[INSTRMT/SHM] Unable to write " << path.c_str();
+  else
+    message << instrmt::ansi::escape_sequence(style::green_fg) << "[INSTRMT/SHM] Dumped "
+            << static_cast<unsigned long long>(count) << " events to " << path.c_str();
+  message << " (" << reason << ")" << instrmt::ansi::escape_sequence(style::reset) << "\n";
+  message.write_to(STDERR_FILENO);
+}
+
+// Alternate signal stack of a thread, so that a stack overflow can be dumped.
+class AltStack {
+private:
+  static constexpr std::size_t size = 128 * 1024;
+  void* stack = nullptr;
+
+public:
+  AltStack() = default;
+  AltStack(const AltStack&) = delete;
+  AltStack& operator=(const AltStack&) = delete;
+
+  // Keeps the stack installed by the application, if any.
+  void install() {
+    stack_t current;
+    if (sigaltstack(nullptr, &current) != 0 || !(current.ss_flags & SS_DISABLE))
+      return;
+
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED)
+      return;
+
+    stack_t ss;
+    ss.ss_sp = addr;
+    ss.ss_flags = 0;
+    ss.ss_size = size;
+    if (sigaltstack(&ss, nullptr) != 0) {
+      munmap(addr, size);
+      return;
+    }
+    stack = addr;
+  }
+
+  ~AltStack() {
+    if (stack) {
+      stack_t ss;
+      std::memset(&ss, 0, sizeof(ss));
+      ss.ss_flags = SS_DISABLE;
+      sigaltstack(&ss, nullptr);
+      munmap(stack, size);
+    }
+  }
+};
+
+std::uint32_t register_site(const char* name, const char* file, int line, std::uint64_t id, const char* types = "") {
+  instrmt::shm::RingHeader* header = segment.header;
+
+  const std::uint32_t index = header->site_count.fetch_add(1, std::memory_order_relaxed);
+  if (index >= header->max_sites)
+    return invalid_site;
+
+  instrmt::shm::SiteSlot& slot = instrmt::shm::sites(header)[index];
+  slot.site.line = static_cast<std::uint32_t>(line);
+  slot.site.id = id;
+  instrmt::trace::copy_string(slot.site.name, sizeof(slot.site.name), name);
+  instrmt::trace::copy_string(slot.site.file, sizeof(slot.site.file), file);
+  instrmt::trace::copy_types(slot.site.types, types);
+  slot.ready.store(1, std::memory_order_release);
+
+  return index;
+}
+
+class ThreadLane {
+private:
+  instrmt::shm::LaneHeader* lane = nullptr;
+  instrmt::trace::Event* events = nullptr;
+  std::uint64_t mask = 0;
+  std::uint32_t tid;
+  bool acquired = false;
+  AltStack alt_stack;
+
+  void acquire() {
+    acquired = true;
+
+    if (recorder.crash_dumps)
+      alt_stack.install();
+
+    instrmt::shm::RingHeader* header = segment.header;
+    for (std::uint32_t i = 0; i < header->lane_count; ++i) {
+      instrmt::shm::LaneHeader* candidate = instrmt::shm::lane(header, i);
+      std::uint32_t expected = 0;
+      if (candidate->owner.compare_exchange_strong(expected, tid, std::memory_order_acq_rel)) {
+        lane = candidate;
+        events = instrmt::shm::events(lane);
+        mask = header->lane_capacity - 1;
+        header->thread_count.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    }
+  }
+
+public:
+  std::uint16_t depth = 0;
+
+  ThreadLane()
+    : tid(static_cast<std::uint32_t>(syscall(SYS_gettid)))
+  {}
+
+  ~ThreadLane() {
+    if (lane) {
+      segment.header->thread_count.fetch_sub(1, std::memory_order_relaxed);
+      lane->owner.store(0, std::memory_order_release);
+      // Events emitted later during the thread's teardown are dropped, the
+      // lane may already belong to another thread.
+      lane = nullptr;
+    }
+  }
+
+  // Returns the slot of the next event, or nullptr if the thread has no lane.
+  // The events following it are available through slot().
+  instrmt::trace::Event* next() {
+    if (!acquired)
+      acquire();
+
+    if (lane == nullptr) {
+      segment.header->dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    instrmt::trace::Event* event = slot(0);
+    event->tid = tid;
+    event->depth = depth;
+    return event;
+  }
+
+  // The i-th event reserved by next().
+  instrmt::trace::Event* slot(std::size_t i) const {
+    return &events[(lane->head.load(std::memory_order_relaxed) + i) & mask];
+  }
+
+  // Lanes smaller than a long message truncate it.
+  std::size_t capacity() const {
+    return mask + 1;
+  }
+
+  void commit(std::size_t count = 1) {
+    lane->head.store(lane->head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+  }
+};
+
+thread_local ThreadLane thread_lane;
+
+} // anonymous namespace
+
+namespace instrmt {
+namespace shm {
+
+class Region : public instrmt::Region {
+private:
+  std::uint32_t site;
+  std::uint64_t start;
+
+public:
+  explicit Region(std::uint32_t site)
+    : instrmt::Region()
+    , site(site)
+    , start(trace::monotonic_ns())
+  {
+    ++thread_lane.depth;
+  }
+
+  ~Region() {
+    const std::uint64_t end = trace::monotonic_ns();
+    --thread_lane.depth;
+
+    if (trace::Event* event = thread_lane.next()) {
+      event->time = start;
+      event->duration = end - start;
+      event->site = site;
+      event->kind = static_cast<std::uint16_t>(trace::EventKind::region);
+      event->size = 0;
+      thread_lane.commit();
+    }
+
+    if (recorder.slow_threshold != 0 && end - start >= recorder.slow_threshold)
+      recorder.on_slow_region(end);
+  }
+};
+
+class RegionContext : public instrmt::RegionContext {
+private:
+  std::uint32_t site;
+
+public:
+  explicit RegionContext(std::uint32_t site)
+    : instrmt::RegionContext()
+    , site(site)
+  {}
+
+  Region* make_region_ptr() override {
+    return new Region(site);
+  }
+};
+
+class LiteralMessageContext : public instrmt::LiteralMessageContext {
+private:
+  std::uint32_t site;
+
+public:
+  explicit LiteralMessageContext(std::uint32_t site)
+    : instrmt::LiteralMessageContext()
+    , site(site)
+  {}
+
+  void emit_message() const override {
+    if (trace::Event* event = thread_lane.next()) {
+      event->time = trace::monotonic_ns();
+      event->duration = 0;
+      event->site = site;
+      event->kind = static_cast<std::uint16_t>(trace::EventKind::literal_message);
+      event->size = 0;
+      thread_lane.commit();
+    }
+  }
+};
+
+class FormattedMessageContext : public instrmt::FormattedMessageContext {
+private:
+  std::uint32_t site;
+
+public:
+  explicit FormattedMessageContext(std::uint32_t site)
+    : instrmt::FormattedMessageContext()
+    , site(site)
+  {}
+
+  void emit_message(const void* args, std::size_t size) const override;
+};
+
+::instrmt::RegionContext* make_region_context(const char* name,
+                                              const char* function,
+                                              const char* file,
+                                              int line,
+                                              std::uint64_t id)
+{
+  return new instrmt::shm::RegionContext(register_site(name ? name : function, file, line, id));
+}
+
+::instrmt::LiteralMessageContext* make_literal_message_context(const char* msg, std::uint64_t id)
+{
+  return new instrmt::shm::LiteralMessageContext(register_site(msg, "", 0, id));
+}
+
+::instrmt::FormattedMessageContext* make_formatted_message_context(const char* fmt,
+                                                                  const char* types,
+                                                                  const char* file,
+                                                                  int line,
+                                                                  std::uint64_t id)
+{
+  return new instrmt::shm::FormattedMessageContext(register_site(fmt, file, line, id, types));
+}
+
+// Long texts are stored in continuation events, see trace::store_text().
+void emit_text(trace::EventKind kind, std::uint32_t site, const void* text, std::size_t size) {
+  if (trace::Event* event = thread_lane.next()) {
+    const std::size_t count = trace::text_events(size, thread_lane.capacity());
+    event->time = trace::monotonic_ns();
+    event->duration = 0;
+    event->site = site;
+    event->kind = static_cast<std::uint16_t>(kind);
+    trace::store_text([](std::size_t i) { return thread_lane.slot(i); }, count, text, size);
+    thread_lane.commit(count);
+  }
+}
+
+void instrmt_dynamic_message(const char* msg, std::size_t len)
+{
+  emit_text(trace::EventKind::message, invalid_site, msg, len);
+}
+
+// The arguments are stored in the events and formatted by the reader.
+void FormattedMessageContext::emit_message(const void* args, std::size_t size) const {
+  emit_text(trace::EventKind::formatted_message, site, args, size);
+}
+
+} // namespace shm
+} // namespace instrmt
+
+extern "C" {
+
+instrmt::InstrmtEngine make_instrmt_engine_v2() {
+  try {
+    const std::uint32_t lane_count = parse_env(shm_lanes_env, 64);
+    const std::uint32_t lane_capacity = parse_env(shm_lane_size_env, 16384);
+    const std::uint32_t max_sites = parse_env(shm_max_sites_env, 65536);
+
+    if ((lane_capacity & (lane_capacity - 1)) != 0)
+      throw std::runtime_error(std::string(shm_lane_size_env) + " must be a power of two");
+
+    const char* dump_path = getenv(shm_dump_env);
+    const std::uint64_t window = getenv(shm_dump_window_env) ? parse_env(shm_dump_window_env, 0) * 1000000000ull : 0;
+    const std::uint64_t slow = getenv(shm_dump_slow_env) ? parse_env(shm_dump_slow_env, 0) * 1000000ull : 0;
+    bool on_crash = true;
+    if (const char* value = getenv(shm_dump_on_crash_env)) {
+      if (std::strcmp(value, "yes") != 0 && std::strcmp(value, "no") != 0)
+        throw std::runtime_error(std::string("invalid value for ") + shm_dump_on_crash_env + ": " + value);
+      on_crash = std::strcmp(value, "yes") == 0;
+    }
+
+    segment.create(lane_count, lane_capacity, max_sites);
+
+    std::cerr << style::green_fg << "[INSTRMT/SHM] Publishing events to /dev/shm" << segment.path()
+              << " (lanes=" << lane_count << ", lane_size=" << lane_capacity << ", max_sites=" << max_sites << ")"
+              << style::reset << std::endl;
+
+    if (dump_path) {
+      recorder.configure(dump_path, window, slow, on_crash);
+
+      std::cerr << style::green_fg << "[INSTRMT/SHM] Flight recorder enabled, dumping to " << dump_path << ".<N>"
+                << " on SIGUSR1" << (slow ? ", slow regions" : "") << (on_crash ? ", crashes" : "")
+                << style::reset << std::endl;
+    }
+  } catch (const std::exception& ex) {
+    std::cerr << style::red_bg << "[INSTRMT/SHM] " << ex.what() << ", instrumentation disabled" << style::reset << std::endl;
+    return {nullptr, nullptr, nullptr, nullptr};
+  }
+
+  return {
+    instrmt::shm::make_region_context,
+    instrmt::shm::make_literal_message_context,
+    instrmt::shm::instrmt_dynamic_message,
+    instrmt::shm::make_formatted_message_context
+  };
+}
+
+} // extern C
@@ -0,0 +1,91 @@
+#ifndef INSTRMTSHMRING_HXX
+#define INSTRMTSHMRING_HXX
+
+#include <instrmt/details/trace-format.hxx>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Layout of the shared memory segment published by the shm engine.
+//
+//   RingHeader | SiteSlot[max_sites] | (LaneHeader | Event[lane_capacity])[lane_count]
+//
+// Each lane has a single writer (the thread owning it) and is used as a ring:
+// event #i is stored in slot i % lane_capacity, and `head` is the number of
+// events ever written to the lane. Readers copy the events, then check that the
+// writer did not wrap over them in the meantime.
+
+namespace instrmt {
+namespace shm {
+
+constexpr char ring_magic[8] = {'I', 'N', 'S', 'T', 'R', 'S', 'H', 'M'};
+constexpr std::uint32_t ring_version = 4;
+
+struct alignas(64) RingHeader {
+  char magic[8];                          // Written last, once the segment is initialized.
+  std::uint32_t version;
+  std::uint32_t pid;
+  std::uint32_t lane_count;
+  std::uint32_t lane_capacity;            // Power of two.
+  std::uint32_t max_sites;
+  std::uint32_t reserved;
+  std::int64_t clock_offset;              // See trace::FileHeader.
+  std::atomic<std::uint32_t> site_count;  // Number of reserved site slots.
+  std::atomic<std::uint32_t> thread_count;
+  std::atomic<std::uint64_t> dropped;     // Events of threads that could not get a lane.
+};
+
+struct SiteSlot {
+  std::atomic<std::uint64_t> ready;       // Set once the site is written.
+  trace::Site site;
+};
+
+struct alignas(64) LaneHeader {
+  std::atomic<std::uint64_t> head;
+  std::atomic<std::uint32_t> owner;       // Thread id, 0 if the lane is free.
+};
+
+inline std::string segment_name(unsigned long pid) {
+  return "/instrmt." + std::to_string(pid);
+}
+
+inline std::size_t lane_stride(std::uint32_t lane_capacity) {
+  return sizeof(LaneHeader) + lane_capacity * sizeof(trace::Event);
+}
+
+inline std::size_t segment_size(std::uint32_t max_sites, std::uint32_t lane_count, std::uint32_t lane_capacity) {
+  const std::size_t sites = (max_sites * sizeof(SiteSlot) + 63) / 64 * 64;
+  return sizeof(RingHeader) + sites + lane_count * lane_stride(lane_capacity);
+}
+
+inline SiteSlot* sites(RingHeader* header) {
+  return reinterpret_cast<SiteSlot*>(header + 1);
+}
+
+inline const SiteSlot* sites(const RingHeader* header) {
+  return reinterpret_cast<const SiteSlot*>(header + 1);
+}
+
+inline LaneHeader* lane(RingHeader* header, std::uint32_t i) {
+  char* base = reinterpret_cast<char*>(header) + segment_size(header->max_sites, 0, 0);
+  return reinterpret_cast<LaneHeader*>(base + i * lane_stride(header->lane_capacity));
+}
+
+inline const LaneHeader* lane(const RingHeader* header, std::uint32_t i) {
+  return lane(const_cast<RingHeader*>(header), i);
+}
+
+inline trace::Event* events(LaneHeader* lane) {
+  return reinterpret_cast<trace::Event*>(lane + 1);
+}
+
+inline const trace::Event* events(const LaneHeader* lane) {
+  return reinterpret_cast<const trace::Event*>(lane + 1);
+}
+
+} // namespace shm
+} // namespace instrmt
+
+#endif // INSTRMTSHMRING_HXX
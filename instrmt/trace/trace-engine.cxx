@@ -0,0 +1,386 @@
+#include <instrmt/details/base.hxx>
+#include <instrmt/details/engine.hxx>
+#include <instrmt/details/trace-format.hxx>
+#include <instrmt/details/utils.hxx>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using instrmt::ansi::style;
+
+// The trace file is written through shared mappings: every byte stored in a
+// chunk immediately belongs to the page cache, and is not lost if the process
+// is killed. The file is made of chunks, each holding a single block:
+//
+//   FileHeader | sites block | events block (thread A) | events block (thread B) | sites block | ...
+//
+// Chunks are allocated at the end of the file, and their BlockHeader is written
+// before the next chunk can be allocated, so a reader never meets an unwritten
+// header. Items are written first, then published by incrementing the count of
+// their block, so a trace cut at any point only contains complete items.
+
+namespace {
+
+using instrmt::trace::BlockHeader;
+using instrmt::trace::BlockType;
+using instrmt::trace::Event;
+using instrmt::trace::Site;
+
+const char trace_out_env[] = "INSTRMT_TRACE_OUT";
+const char trace_chunk_size_env[] = "INSTRMT_TRACE_CHUNK_SIZE";
+
+constexpr std::uint32_t invalid_site = 0xFFFFFFFF;
+constexpr std::uint64_t sites_per_chunk = 1024;
+
+std::uint32_t parse_env(const char* e, std::uint32_t def) {
+  const char* value = getenv(e);
+  if (value == nullptr)
+    return def;
+
+  char* end = nullptr;
+  const unsigned long v = std::strtoul(value, &end, 10);
+  if (end == value || *end != '\0' || v == 0 || v > 0xFFFFFFFFul)
+    throw std::runtime_error(std::string("invalid value for ") + e + ": " + value);
+  return static_cast<std::uint32_t>(v);
+}
+
+// A block mapped from the trace file. The mapping starts at the page containing
+// the block, chunks are contiguous and may share pages.
+class Chunk {
+private:
+  void* addr = MAP_FAILED;
+  std::size_t size = 0;
+
+public:
+  BlockHeader* block = nullptr;
+
+  Chunk() = default;
+
+  Chunk(int fd, off_t offset, std::size_t bytes) {
+    const off_t page = static_cast<off_t>(sysconf(_SC_PAGESIZE));
+    const off_t start = offset / page * page;
+    size = static_cast<std::size_t>(offset - start) + bytes;
+    addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, start);
+    if (addr == MAP_FAILED)
+      throw std::runtime_error(std::string("unable to map the trace (") + std::strerror(errno) + ")");
+    block = reinterpret_cast<BlockHeader*>(static_cast<char*>(addr) + (offset - start));
+  }
+
+  Chunk(const Chunk&) = delete;
+  Chunk& operator=(const Chunk&) = delete;
+
+  Chunk(Chunk&& other) {
+    *this = std::move(other);
+  }
+
+  Chunk& operator=(Chunk&& other) {
+    std::swap(addr, other.addr);
+    std::swap(size, other.size);
+    std::swap(block, other.block);
+    return *this;
+  }
+
+  ~Chunk() {
+    if (addr != MAP_FAILED)
+      munmap(addr, size);
+  }
+
+  template<typename T>
+  T* items() const { return reinterpret_cast<T*>(block + 1); }
+};
+
+class TraceFile {
+private:
+  int fd = -1;
+  std::mutex mutex;
+  off_t end = 0;
+  Chunk sites;
+  std::uint32_t site_count = 0;
+
+  // Must be called with the mutex held.
+  Chunk allocate_locked(BlockType type, std::uint32_t item_size, std::uint64_t capacity, std::uint64_t first) {
+    const off_t offset = end;
+    const std::size_t bytes = sizeof(BlockHeader) + capacity * item_size;
+
+    if (ftruncate(fd, offset + static_cast<off_t>(bytes)) != 0)
+      throw std::runtime_error(std::string("unable to extend the trace (") + std::strerror(errno) + ")");
+
+    Chunk chunk(fd, offset, bytes);
+    chunk.block->type = static_cast<std::uint32_t>(type);
+    chunk.block->item_size = item_size;
+    chunk.block->capacity = capacity;
+    chunk.block->first = first;
+    chunk.block->count.store(0, std::memory_order_release);
+
+    end = offset + static_cast<off_t>(bytes);
+    return chunk;
+  }
+
+public:
+  std::uint64_t events_per_chunk = 0;
+
+  void open(const std::string& path, std::uint64_t chunk_size) {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+      throw std::runtime_error("unable to open " + path + " (" + std::strerror(errno) + ")");
+
+    instrmt::trace::FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, instrmt::trace::file_magic, sizeof(header.magic));
+    header.version = instrmt::trace::file_version;
+    header.pid = static_cast<std::uint32_t>(getpid());
+    header.clock_offset = instrmt::trace::clock_offset();
+    if (pwrite(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)))
+      throw std::runtime_error("unable to write " + path + " (" + std::strerror(errno) + ")");
+
+    end = sizeof(header);
+    events_per_chunk = chunk_size;
+  }
+
+  ~TraceFile() {
+    sites = Chunk();
+    if (fd >= 0)
+      close(fd);
+  }
+
+  Chunk allocate_events() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return allocate_locked(BlockType::events, sizeof(Event), events_per_chunk, 0);
+  }
+
+  std::uint32_t register_site(const char* name, const char* file, int line, std::uint64_t id, const char* types = "") {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (sites.block == nullptr || sites.block->count.load(std::memory_order_relaxed) == sites.block->capacity)
+      sites = allocate_locked(BlockType::sites, sizeof(Site), sites_per_chunk, site_count);
+
+    const std::uint64_t index = sites.block->count.load(std::memory_order_relaxed);
+    Site& site = sites.items<Site>()[index];
+    site.line = static_cast<std::uint32_t>(line);
+    site.id = id;
+    instrmt::trace::copy_string(site.name, sizeof(site.name), name);
+    instrmt::trace::copy_string(site.file, sizeof(site.file), file);
+    instrmt::trace::copy_types(site.types, types);
+    sites.block->count.store(index + 1, std::memory_order_release);
+
+    return site_count++;
+  }
+};
+
+TraceFile trace_file;
+
+class ThreadChunk {
+private:
+  Chunk chunk;
+  std::uint32_t tid;
+  bool failed = false;
+
+public:
+  std::uint16_t depth = 0;
+
+  ThreadChunk()
+    : tid(static_cast<std::uint32_t>(syscall(SYS_gettid)))
+  {}
+
+  // Returns the slot of the next event, or nullptr if no chunk can be allocated.
+  // The `count` events following it belong to the same chunk.
+  Event* next(std::size_t count = 1) {
+    if (chunk.block == nullptr || chunk.block->capacity - chunk.block->count.load(std::memory_order_relaxed) < count) {
+      if (failed)
+        return nullptr;
+
+      try {
+        chunk = trace_file.allocate_events();
+      } catch (const std::exception& ex) {
+        failed = true;
+        chunk = Chunk();
+        std::cerr << style::red_bg << "[INSTRMT/TRACE] " << ex.what() << ", events of thread " << tid << " dropped" << style::reset << std::endl;
+        return nullptr;
+      }
+    }
+
+    Event* event = &chunk.items<Event>()[chunk.block->count.load(std::memory_order_relaxed)];
+    event->tid = tid;
+    event->depth = depth;
+    event->reserved = 0;
+    return event;
+  }
+
+  void commit(std::size_t count = 1) {
+    chunk.block->count.store(chunk.block->count.load(std::memory_order_relaxed) + count, std::memory_order_release);
+  }
+};
+
+thread_local ThreadChunk thread_chunk;
+
+} // anonymous namespace
+
+namespace instrmt {
+namespace trace {
+
+class Region : public instrmt::Region {
+private:
+  std::uint32_t site;
+  std::uint64_t start;
+
+public:
+  explicit Region(std::uint32_t site)
+    : instrmt::Region()
+    , site(site)
+    , start(monotonic_ns())
+  {
+    ++thread_chunk.depth;
+  }
+
+  ~Region() {
+    const std::uint64_t end = monotonic_ns();
+    --thread_chunk.depth;
+
+    if (Event* event = thread_chunk.next()) {
+      event->time = start;
+      event->duration = end - start;
+      event->site = site;
+      event->kind = static_cast<std::uint16_t>(EventKind::region);
+      event->size = 0;
+      thread_chunk.commit();
+    }
+  }
+};
+
+class RegionContext : public instrmt::RegionContext {
+private:
+  std::uint32_t site;
+
+public:
+  explicit RegionContext(std::uint32_t site)
+    : instrmt::RegionContext()
+    , site(site)
+  {}
+
+  Region* make_region_ptr() override {
+    return new Region(site);
+  }
+};
+
+class LiteralMessageContext : public instrmt::LiteralMessageContext {
+private:
+  std::uint32_t site;
+
+public:
+  explicit LiteralMessageContext(std::uint32_t site)
+    : instrmt::LiteralMessageContext()
+    , site(site)
+  {}
+
+  void emit_message() const override {
+    if (Event* event = thread_chunk.next()) {
+      event->time = monotonic_ns();
+      event->duration = 0;
+      event->site = site;
+      event->kind = static_cast<std::uint16_t>(EventKind::literal_message);
+      event->size = 0;
+      thread_chunk.commit();
+    }
+  }
+};
+
+class FormattedMessageContext : public instrmt::FormattedMessageContext {
+private:
+  std::uint32_t site;
+
+public:
+  explicit FormattedMessageContext(std::uint32_t site)
+    : instrmt::FormattedMessageContext()
+    , site(site)
+  {}
+
+  void emit_message(const void* args, std::size_t size) const override;
+};
+
+::instrmt::RegionContext* make_region_context(const char* name,
+                                              const char* function,
+                                              const char* file,
+                                              int line,
+                                              std::uint64_t id)
+{
+  return new instrmt::trace::RegionContext(trace_file.register_site(name ? name : function, file, line, id));
+}
+
+::instrmt::LiteralMessageContext* make_literal_message_context(const char* msg, std::uint64_t id)
+{
+  return new instrmt::trace::LiteralMessageContext(trace_file.register_site(msg, "", 0, id));
+}
+
+::instrmt::FormattedMessageContext* make_formatted_message_context(const char* fmt,
+                                                                  const char* types,
+                                                                  const char* file,
+                                                                  int line,
+                                                                  std::uint64_t id)
+{
+  return new instrmt::trace::FormattedMessageContext(trace_file.register_site(fmt, file, line, id, types));
+}
+
+// Long texts are stored in continuation events, see store_text(). Chunks
+// smaller than a long message truncate it.
+void emit_text(EventKind kind, std::uint32_t site, const void* text, std::size_t size) {
+  const std::size_t count = text_events(size, trace_file.events_per_chunk);
+  if (Event* event = thread_chunk.next(count)) {
+    event->time = monotonic_ns();
+    event->duration = 0;
+    event->site = site;
+    event->kind = static_cast<std::uint16_t>(kind);
+    store_text([event](std::size_t i) { return event + i; }, count, text, size);
+    thread_chunk.commit(count);
+  }
+}
+
+void instrmt_dynamic_message(const char* msg, std::size_t len)
+{
+  emit_text(EventKind::message, invalid_site, msg, len);
+}
+
+// The arguments are stored in the events and formatted by the reader.
+void FormattedMessageContext::emit_message(const void* args, std::size_t size) const {
+  emit_text(EventKind::formatted_message, site, args, size);
+}
+
+} // namespace trace
+} // namespace instrmt
+
+extern "C" {
+
+instrmt::InstrmtEngine make_instrmt_engine_v2() {
+  try {
+    const char* out = getenv(trace_out_env);
+    const std::string path = out ? out : "instrmt." + std::to_string(getpid()) + ".trace";
+    const std::uint32_t chunk_size = parse_env(trace_chunk_size_env, 16384);
+
+    trace_file.open(path, chunk_size);
+
+    std::cerr << style::green_fg << "[INSTRMT/TRACE] Writing events to " << path
+              << " (chunk_size=" << chunk_size << ")" << style::reset << std::endl;
+  } catch (const std::exception& ex) {
+    std::cerr << style::red_bg << "[INSTRMT/TRACE] " << ex.what() << ", instrumentation disabled" << style::reset << std::endl;
+    return {nullptr, nullptr, nullptr, nullptr};
+  }
+
+  return {
+    instrmt::trace::make_region_context,
+    instrmt::trace::make_literal_message_context,
+    instrmt::trace::instrmt_dynamic_message,
+    instrmt::trace::make_formatted_message_context
+  };
+}
+
+} // extern C
@@ -65,19 +65,20 @@ public:
 instrmt::RegionContext* make_region_context(const char* name,
                                             const char *function,
                                             const char *file,
-                                            int line)
+                                            int line,
+                                            std::uint64_t /*id*/)
 {
   return new instrmt::tracy::RegionContext(name, function, file, line);
 }
 
-::instrmt::LiteralMessageContext* make_literal_message_context(const char* msg)
+::instrmt::LiteralMessageContext* make_literal_message_context(const char* msg, std::uint64_t /*id*/)
 {
   return new instrmt::tracy::LiteralMessageContext(msg);
 }
 
-void instrmt_dynamic_message(const char* msg)
+void instrmt_dynamic_message(const char* msg, std::size_t len)
 {
-  ___tracy_emit_message(msg, strlen(msg), 0);
+  ___tracy_emit_message(msg, len, 0);
 }
 
 } // namespace tracy
@@ -85,11 +86,12 @@ void instrmt_dynamic_message(const char* msg)
 
 extern "C" {
 
-instrmt::InstrmtEngine make_instrmt_engine() {
+instrmt::InstrmtEngine make_instrmt_engine_v2() {
   return {
     instrmt::tracy::make_region_context,
     instrmt::tracy::make_literal_message_context,
-    instrmt::tracy::instrmt_dynamic_message
+    instrmt::tracy::instrmt_dynamic_message,
+    nullptr // Formatted messages are formatted by the core.
   };
 }
 
@@ -0,0 +1,95 @@
+#ifndef INSTRMTTRACYPOLICY_HXX
+#define INSTRMTTRACYPOLICY_HXX
+
+#include <tracy/TracyC.h>
+
+#include <cstring>
+#include <string>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+class InstrmtTracyRegion {
+private:
+  TracyCZoneCtx tracyctx;
+  bool live = true;
+
+public:
+  explicit InstrmtTracyRegion(const struct ___tracy_source_location_data* srcloc)
+    : tracyctx(___tracy_emit_zone_begin(srcloc, true))
+  {}
+
+  void terminate() {
+    if (live) {
+      live = false;
+      ___tracy_emit_zone_end(tracyctx);
+    }
+  }
+
+  ~InstrmtTracyRegion() {
+    terminate();
+  }
+};
+
+inline void instrmt_tracy_emit_message(const char* msg)
+{
+  ___tracy_emit_message(msg, strlen(msg), 0);
+}
+
+inline void instrmt_tracy_emit_message(const char* msg, size_t len)
+{
+  ___tracy_emit_message(msg, len, 0);
+}
+
+inline void instrmt_tracy_emit_message(const std::string& msg)
+{
+  ___tracy_emit_message(msg.data(), msg.size(), 0);
+}
+
+#if __cplusplus >= 201703L
+inline void instrmt_tracy_emit_message(std::string_view msg)
+{
+  ___tracy_emit_message(msg.data(), msg.size(), 0);
+}
+#endif
+
+namespace instrmt {
+
+// Policy of the Tracy wrapper, see instrmt/details/compose.hxx.
+struct TracyPolicy {
+  struct Site {
+    struct ___tracy_source_location_data srcloc;
+
+    constexpr Site(const char* name, const char* function, const char* file, int line)
+      : srcloc{name, function, file, (uint32_t)line, 0}
+    {}
+  };
+
+  class Region : public InstrmtTracyRegion {
+  public:
+    explicit Region(const Site& site)
+      : InstrmtTracyRegion(&site.srcloc)
+    {}
+  };
+
+  struct LiteralMessageSite {
+    const char* msg;
+
+    explicit constexpr LiteralMessageSite(const char* msg)
+      : msg(msg)
+    {}
+  };
+
+  static void emit_literal_message(const LiteralMessageSite& site) {
+    ___tracy_emit_messageL(site.msg, 0);
+  }
+
+  static void emit_message(const char* msg, size_t len) {
+    instrmt_tracy_emit_message(msg, len);
+  }
+};
+
+} // namespace instrmt
+
+#endif // INSTRMTTRACYPOLICY_HXX
@@ -1,36 +1,8 @@
 #ifndef INSTRMTTRACYWRAPPER_HXX
 #define INSTRMTTRACYWRAPPER_HXX
 
-#include <tracy/TracyC.h>
-
-#include <cstring>
-
-class InstrmtTracyRegion {
-private:
-  TracyCZoneCtx tracyctx;
-  bool live = true;
-
-public:
-  explicit InstrmtTracyRegion(const struct ___tracy_source_location_data* srcloc)
-    : tracyctx(___tracy_emit_zone_begin(srcloc, true))
-  {}
-
-  void terminate() {
-    if (live) {
-      live = false;
-      ___tracy_emit_zone_end(tracyctx);
-    }
-  }
-
-  ~InstrmtTracyRegion() {
-    terminate();
-  }
-};
-
-inline void instrmt_tracy_emit_message(const char* msg)
-{
-  ___tracy_emit_message(msg, strlen(msg), 0);
-}
+#include <instrmt/tracy/tracy-policy.hxx>
+#include <instrmt/details/format.hxx>
 
 #define INSTRMT_NAMED_REGION(VAR, NAME) \
   static const struct ___tracy_source_location_data TracyConcat(VAR, _tracy_source_location) = { NAME, __FUNCTION__,  __FILE__, (uint32_t)__LINE__, 0 }; \
@@ -46,7 +18,11 @@ inline void instrmt_tracy_emit_message(const char* msg)
 
 #define INSTRMT_REGION_END() INSTRMT_NAMED_REGION_END(_)
 
+#ifdef INSTRMT_QUALIFIED_FUNCTION_NAMES
+#define INSTRMT_FUNCTION() INSTRMT_QUALIFIED_FUNCTION()
+#else
 #define INSTRMT_FUNCTION() INSTRMT_NAMED_REGION(_, (char*)0)
+#endif
 
 #define INSTRMT_NAMED_LITERAL_MESSAGE(VAR, MSG) \
   ___tracy_emit_messageL(MSG, 0);
@@ -57,4 +33,13 @@ inline void instrmt_tracy_emit_message(const char* msg)
 #define INSTRMT_MESSAGE(MSG) \
   instrmt_tracy_emit_message(MSG);
 
+#define INSTRMT_MESSAGE_N(MSG, LEN) \
+  instrmt_tracy_emit_message(MSG, LEN);
+
+#define INSTRMT_NAMED_MESSAGEF(VAR, ...) \
+  instrmt_tracy_emit_message(::instrmt::format::now(__VA_ARGS__));
+
+#define INSTRMT_MESSAGEF(...) \
+  INSTRMT_NAMED_MESSAGEF(_, __VA_ARGS__)
+
 #endif // INSTRMTTRACYWRAPPER_HXX
@@ -1,5 +1,6 @@
 #include <instrmt/details/base.hxx>
 #include <instrmt/details/engine.hxx>
+#include <instrmt/details/perf-counters.hxx>
 #include <instrmt/details/utils.hxx>
 
 #include <ctime>
@@ -8,8 +9,11 @@
 #include <string>
 #include <iostream>
 #include <utility>
+#include <vector>
 #include <unistd.h>
+#include <sys/resource.h>
 
+#include "tty-rotation.hxx"
 #include "tty-utils.h"
 
 using instrmt::ansi::style;
@@ -20,6 +24,12 @@ const char tty_out_env[] = "INSTRMT_TTY_OUT";
 const char tty_truncate_out_env[] = "INSTRMT_TTY_TRUNCATE_OUT";
 const char tty_color_env[] = "INSTRMT_TTY_COLOR";
 const char tty_format_env[] = "INSTRMT_TTY_FORMAT";
+const char tty_counters_env[] = "INSTRMT_TTY_COUNTERS";
+const char tty_cpu_time_env[] = "INSTRMT_TTY_CPU_TIME";
+const char tty_rusage_env[] = "INSTRMT_TTY_RUSAGE";
+const char tty_rotate_env[] = "INSTRMT_TTY_ROTATE";
+const char tty_rotate_interval_env[] = "INSTRMT_TTY_ROTATE_INTERVAL";
+const char tty_rotate_keep_env[] = "INSTRMT_TTY_ROTATE_KEEP";
 
 template<typename Target>
 Target lexical_cast(const std::string& value);
@@ -155,7 +165,13 @@ struct Sink {
 
 struct Config {
   Sink sink{stderr};
+  // Must be stopped before the sink is closed.
+  std::unique_ptr<instrmt::tty::Rotator> rotator;
   OutputFormat format = OutputFormat::text;
+  bool cpu_time = false;
+  std::vector<instrmt::perf::Counter> counters;
+  bool rusage = false;
+  std::vector<std::string> rusage_sites; // Empty means all sites.
 };
 
 std::string format_file(std::string fmt) {
@@ -188,6 +204,199 @@ Sink make_sink() {
 
 Config config;
 
+void configure_rotation() {
+  const char* env_size = getenv(tty_rotate_env);
+  const char* env_interval = getenv(tty_rotate_interval_env);
+  if (env_size == nullptr && env_interval == nullptr)
+    return;
+
+  if (!config.sink.do_close) {
+    std::cerr << style::red_bg << "[INSTRMT/TTY] Cannot rotate " << config.sink.name << style::reset << std::endl;
+    return;
+  }
+
+  instrmt::tty::RotationPolicy policy;
+  try {
+    if (env_size)
+      policy.max_size = instrmt::tty::parse_size(env_size);
+    if (env_interval)
+      policy.max_age = instrmt::tty::parse_duration(env_interval);
+    if (const char* env_keep = getenv(tty_rotate_keep_env))
+      policy.keep = instrmt::tty::parse_count(env_keep);
+  } catch (const std::exception& ex) {
+    std::cerr << style::red_bg << "[INSTRMT/TTY] " << ex.what() << ", rotation disabled" << style::reset << std::endl;
+    return;
+  }
+
+  config.rotator.reset(new instrmt::tty::Rotator(config.sink.file, config.sink.name, policy));
+  std::cerr << style::green_fg << "[INSTRMT/TTY] Rotating " << config.sink.name
+            << " (size=" << (env_size ? env_size : "unlimited")
+            << ", interval=" << (env_interval ? env_interval : "unlimited")
+            << ", keep=" << policy.keep << ")" << style::reset << std::endl;
+}
+
+struct ThreadUsage {
+  long voluntary_switches = 0;
+  long involuntary_switches = 0;
+  long minor_faults = 0;
+  long major_faults = 0;
+
+  static ThreadUsage now() {
+    ThreadUsage usage;
+    struct rusage ru;
+    if (getrusage(RUSAGE_THREAD, &ru) == 0) {
+      usage.voluntary_switches = ru.ru_nvcsw;
+      usage.involuntary_switches = ru.ru_nivcsw;
+      usage.minor_faults = ru.ru_minflt;
+      usage.major_faults = ru.ru_majflt;
+    }
+    return usage;
+  }
+};
+
+bool has_rusage(const char* name) {
+  if (!config.rusage)
+    return false;
+
+  if (config.rusage_sites.empty())
+    return true;
+
+  for (const std::string& site : config.rusage_sites)
+    if (site == name)
+      return true;
+
+  return false;
+}
+
+void print_rusage(FILE* file, const ThreadUsage* begin, const ThreadUsage& end) {
+  if (config.format == OutputFormat::text) {
+    if (begin)
+      fprintf(file, " csw=%ld/%ld faults=%ld/%ld",
+              end.voluntary_switches - begin->voluntary_switches,
+              end.involuntary_switches - begin->involuntary_switches,
+              end.minor_faults - begin->minor_faults,
+              end.major_faults - begin->major_faults);
+  } else {
+    // Keep the same number of columns for sites that are not flagged.
+    if (begin)
+      fprintf(file, "; %ld; %ld; %ld; %ld",
+              end.voluntary_switches - begin->voluntary_switches,
+              end.involuntary_switches - begin->involuntary_switches,
+              end.minor_faults - begin->minor_faults,
+              end.major_faults - begin->major_faults);
+    else
+      fputs(";;;;", file);
+  }
+}
+
+void configure_rusage() {
+  const char* env_rusage = getenv(tty_rusage_env);
+  if (env_rusage == nullptr)
+    return;
+
+  const std::string sites = env_rusage;
+  config.rusage = true;
+  if (sites == "all")
+    return;
+
+  std::size_t begin = 0;
+  while (begin <= sites.size()) {
+    std::size_t end = sites.find(',', begin);
+    if (end == std::string::npos)
+      end = sites.size();
+    if (end > begin)
+      config.rusage_sites.push_back(sites.substr(begin, end - begin));
+    begin = end + 1;
+  }
+
+  config.rusage = !config.rusage_sites.empty();
+}
+
+// Counters are attached to a thread, each thread needs its own group.
+thread_local std::unique_ptr<instrmt::perf::CounterGroup> thread_counters;
+
+std::size_t read_counters(std::uint64_t* values) {
+  if (config.counters.empty())
+    return 0;
+
+  if (!thread_counters) {
+    try {
+      thread_counters.reset(new instrmt::perf::CounterGroup(config.counters));
+    } catch (const std::exception&) {
+      // Keep going without counters for this thread.
+      thread_counters.reset(new instrmt::perf::CounterGroup({}));
+    }
+  }
+
+  thread_counters->read(values);
+  return thread_counters->size();
+}
+
+void print_counters(FILE* file, const std::uint64_t* begin, const std::uint64_t* end, std::size_t count) {
+  std::uint64_t instructions = 0, cycles = 0;
+
+  for (std::size_t i = 0; i < count; ++i) {
+    const std::uint64_t delta = end[i] - begin[i];
+
+    if (config.format == OutputFormat::text)
+      fprintf(file, " %s=%llu", instrmt::perf::name(config.counters[i]), static_cast<unsigned long long>(delta));
+    else
+      fprintf(file, "; %llu", static_cast<unsigned long long>(delta));
+
+    if (config.counters[i] == instrmt::perf::Counter::instructions)
+      instructions = delta;
+    else if (config.counters[i] == instrmt::perf::Counter::cycles)
+      cycles = delta;
+  }
+
+  // Keep the same number of columns for threads whose counters could not be opened.
+  if (config.format == OutputFormat::csv)
+    for (std::size_t i = count; i < config.counters.size(); ++i)
+      fputc(';', file);
+
+  if (config.format == OutputFormat::text && cycles != 0)
+    fprintf(file, " ipc=%.2f", static_cast<double>(instructions) / static_cast<double>(cycles));
+}
+
+void configure_counters() {
+  using instrmt::perf::CounterGroup;
+
+  const char* env_counters = getenv(tty_counters_env);
+  if (env_counters == nullptr)
+    return;
+
+  try {
+    config.counters = instrmt::perf::parse_counters(env_counters);
+  } catch (const std::exception& ex) {
+    std::cerr << style::red_bg << "[INSTRMT/TTY] " << ex.what() << ", counters disabled" << style::reset << std::endl;
+    return;
+  }
+
+  try {
+    thread_counters.reset(new CounterGroup(config.counters));
+    return;
+  } catch (const std::exception& ex) {
+    std::cerr << style::red_bg << "[INSTRMT/TTY] " << ex.what() << style::reset << std::endl;
+  }
+
+  bool has_hardware_counters = false;
+  for (auto counter : config.counters)
+    has_hardware_counters = has_hardware_counters || instrmt::perf::is_hardware(counter);
+
+  if (has_hardware_counters) {
+    config.counters = {instrmt::perf::Counter::task_clock, instrmt::perf::Counter::page_faults};
+    try {
+      thread_counters.reset(new CounterGroup(config.counters));
+      std::cerr << style::red_bg << "[INSTRMT/TTY] Hardware counters unavailable, defaulting to task-clock,page-faults" << style::reset << std::endl;
+      return;
+    } catch (const std::exception&) {
+    }
+  }
+
+  std::cerr << style::red_bg << "[INSTRMT/TTY] Counters disabled" << style::reset << std::endl;
+  config.counters.clear();
+}
+
 } // anonymous namespace
 
 namespace instrmt {
@@ -197,10 +406,14 @@ class Region : public instrmt::Region {
 private:
   const char* name;
   double start;
+  double cpu_start;
   int color;
+  std::uint64_t counters[instrmt::perf::max_counters];
+  bool rusage;
+  ThreadUsage usage;
 
 public:
-  explicit Region(const char* name, int color);
+  explicit Region(const char* name, int color, bool rusage);
   ~Region();
 };
 
@@ -208,6 +421,7 @@ class RegionContext : public instrmt::RegionContext {
 private:
   const char* name;
   int color;
+  bool rusage;
 
 public:
   explicit RegionContext(const char* name);
@@ -215,34 +429,66 @@ public:
   Region* make_region_ptr() override;
 };
 
-Region::Region(const char* name, int color)
+Region::Region(const char* name, int color, bool rusage)
   : instrmt::Region()
   , name(name)
   , start(instrmt_get_time_ms())
+  , cpu_start(config.cpu_time ? instrmt_get_cpu_time_ms() : 0.0)
   , color(color)
-{}
+  , rusage(rusage)
+  , usage(rusage ? ThreadUsage::now() : ThreadUsage())
+{
+  read_counters(counters);
+}
 
 Region::~Region()
 {
+  std::uint64_t end_counters[instrmt::perf::max_counters];
+  const std::size_t count = read_counters(end_counters);
+  const double duration = instrmt_get_time_ms() - start;
+  const double cpu_duration = config.cpu_time ? instrmt_get_cpu_time_ms() - cpu_start : 0.0;
+  const ThreadUsage end_usage = rusage ? ThreadUsage::now() : ThreadUsage();
+
+  // Keep lines whole when several threads print at the same time.
+  flockfile(config.sink.file);
+
   if (config.format == OutputFormat::text) {
     if (color == 0)
-      fprintf(config.sink.file, "%-40s %.1f ms\n", name, instrmt_get_time_ms() - start);
+      fprintf(config.sink.file, "%-40s %.1f ms", name, duration);
     else
-      fprintf(config.sink.file, "\e[0;%dm%-40s \e[1;34m%.1f\e[0m ms\n", color, name, instrmt_get_time_ms() - start);
+      fprintf(config.sink.file, "\e[0;%dm%-40s \e[1;34m%.1f\e[0m ms", color, name, duration);
   } else if (config.format == OutputFormat::csv) {
-    fprintf(config.sink.file, "%.3f; %s; %.3f\n", start, name, instrmt_get_time_ms() - start);
+    fprintf(config.sink.file, "%.3f; %s; %.3f", start, name, duration);
+  }
+
+  if (config.cpu_time) {
+    // Both clocks are not read at the exact same time, do not report negative off-cpu time.
+    const double off_cpu_duration = duration > cpu_duration ? duration - cpu_duration : 0.0;
+    if (config.format == OutputFormat::text)
+      fprintf(config.sink.file, " (cpu %.1f ms, off-cpu %.1f ms)", cpu_duration, off_cpu_duration);
+    else
+      fprintf(config.sink.file, "; %.3f; %.3f", cpu_duration, off_cpu_duration);
   }
+
+  if (config.rusage)
+    print_rusage(config.sink.file, rusage ? &usage : nullptr, end_usage);
+
+  print_counters(config.sink.file, counters, end_counters, count);
+  fputc('\n', config.sink.file);
+
+  funlockfile(config.sink.file);
 }
 
 RegionContext::RegionContext(const char* name)
   : instrmt::RegionContext()
   , name(name)
   , color(config.sink.color_support ? instrmt_tty_string_color(name) : 0)
+  , rusage(has_rusage(name))
 {}
 
 Region*RegionContext::make_region_ptr()
 {
-  return new Region(name, color);
+  return new Region(name, color, rusage);
 }
 
 class LiteralMessageContext : public instrmt::LiteralMessageContext {
@@ -272,25 +518,27 @@ public:
 ::instrmt::RegionContext* make_region_context(const char* name,
                                               const char* function,
                                               const char* /*file*/,
-                                              int /*line*/)
+                                              int /*line*/,
+                                              std::uint64_t /*id*/)
 {
   return new instrmt::tty::RegionContext(name ? name : function);
 }
 
-::instrmt::LiteralMessageContext* make_literal_message_context(const char* msg)
+::instrmt::LiteralMessageContext* make_literal_message_context(const char* msg, std::uint64_t /*id*/)
 {
   return new instrmt::tty::LiteralMessageContext(msg);
 }
 
-void instrmt_dynamic_message(const char* msg)
+void instrmt_dynamic_message(const char* msg, std::size_t len)
 {
+  const int n = static_cast<int>(len);
   if (config.format == OutputFormat::text) {
     if (config.sink.color_support)
-      fprintf(config.sink.file, "\e[0;%dm%s\e[0m\n", instrmt_tty_string_color(msg), msg);
+      fprintf(config.sink.file, "\e[0;%dm%.*s\e[0m\n", instrmt_tty_string_color(msg, len), n, msg);
     else
-      fprintf(config.sink.file, "%s\n", msg);
+      fprintf(config.sink.file, "%.*s\n", n, msg);
   } else if (config.format == OutputFormat::csv) {
-    fprintf(config.sink.file, "%.3f; %s\n", instrmt_get_time_ms(), msg);
+    fprintf(config.sink.file, "%.3f; %.*s\n", instrmt_get_time_ms(), n, msg);
   }
 }
 
@@ -299,7 +547,7 @@ void instrmt_dynamic_message(const char* msg)
 
 extern "C" {
 
-instrmt::InstrmtEngine make_instrmt_engine() {
+instrmt::InstrmtEngine make_instrmt_engine_v2() {
   using namespace std::string_literals;
 
   try {
@@ -324,12 +572,26 @@ instrmt::InstrmtEngine make_instrmt_engine() {
     config.sink.configure_color_support(color_mode);
   }
 
-  std::cerr << style::green_fg << "[INSTRMT/TTY] out=" << config.sink.name << ", mode=" << config.sink.mode << ", format=" << config.format << ", color=" << std::boolalpha << config.sink.color_support << style::reset << std::endl;
+  try {
+    config.cpu_time = parse_env<bool>(tty_cpu_time_env, false);
+  } catch (...) {
+    std::cerr << style::red_bg << "[INSTRMT/TTY] Unsupported cpu time mode, defaulting to no" << style::reset << std::endl;
+  }
+
+  configure_rusage();
+  configure_counters();
+  configure_rotation();
+
+  std::cerr << style::green_fg << "[INSTRMT/TTY] out=" << config.sink.name << ", mode=" << config.sink.mode << ", format=" << config.format << ", color=" << std::boolalpha << config.sink.color_support << ", cpu_time=" << config.cpu_time << ", rusage=" << config.rusage;
+  for (std::size_t i = 0; i < config.counters.size(); ++i)
+    std::cerr << (i == 0 ? ", counters=" : ",") << instrmt::perf::name(config.counters[i]);
+  std::cerr << style::reset << std::endl;
 
   return {
     instrmt::tty::make_region_context,
     instrmt::tty::make_literal_message_context,
-    instrmt::tty::instrmt_dynamic_message
+    instrmt::tty::instrmt_dynamic_message,
+    nullptr // Formatted messages are formatted by the core.
   };
 }
 
@@ -0,0 +1,107 @@
+#ifndef INSTRMTTTYPOLICY_HXX
+#define INSTRMTTTYPOLICY_HXX
+
+#include <instrmt/tty/tty-utils.h>
+
+#include <stdio.h>
+
+#include <string>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+struct InstrmtTTYRegionContext {
+  const char* name;
+  int color;
+};
+
+class InstrmtTTYRegion
+{
+private:
+  const struct InstrmtTTYRegionContext& ctx;
+  double start;
+  bool live = true;
+
+public:
+  explicit inline InstrmtTTYRegion(const struct InstrmtTTYRegionContext& ctx)
+    : ctx(ctx)
+    , start(instrmt_get_time_ms())
+  {}
+
+  inline void terminate() {
+    if (live) {
+      live = false;
+      fprintf(stderr, "\e[0;%dm%-40s \e[1;34m%.1f\e[0m ms\n", ctx.color, ctx.name, instrmt_get_time_ms() - start);
+    }
+  }
+
+  inline ~InstrmtTTYRegion() {
+    terminate();
+  }
+};
+
+class InstrmtTTYLiteralMessageContext {
+private:
+  const char* msg;
+  int color;
+
+public:
+  explicit InstrmtTTYLiteralMessageContext(const char* msg)
+    : msg(msg)
+    , color(instrmt_tty_string_color(msg))
+  {}
+
+  void emit_message() const {
+    fprintf(stderr, "\e[0;%dm%-40s\e[0m\n", color, msg);
+  }
+};
+
+inline void instrmt_tty_emit_message(const char* msg)
+{
+  fprintf(stderr, "\e[0;%dm%-40s\e[0m\n", instrmt_tty_string_color(msg), msg);
+}
+
+inline void instrmt_tty_emit_message(const char* msg, size_t len)
+{
+  fprintf(stderr, "\e[0;%dm%-40.*s\e[0m\n", instrmt_tty_string_color(msg, len), (int)len, msg);
+}
+
+inline void instrmt_tty_emit_message(const std::string& msg)
+{
+  instrmt_tty_emit_message(msg.data(), msg.size());
+}
+
+#if __cplusplus >= 201703L
+inline void instrmt_tty_emit_message(std::string_view msg)
+{
+  instrmt_tty_emit_message(msg.data(), msg.size());
+}
+#endif
+
+namespace instrmt {
+
+// Policy of the tty wrapper, see instrmt/details/compose.hxx.
+struct TTYPolicy {
+  struct Site : InstrmtTTYRegionContext {
+    Site(const char* name, const char* /*function*/, const char* /*file*/, int /*line*/)
+      : InstrmtTTYRegionContext{name, instrmt_tty_string_color(name)}
+    {}
+  };
+
+  typedef InstrmtTTYRegion Region;
+
+  typedef InstrmtTTYLiteralMessageContext LiteralMessageSite;
+
+  static void emit_literal_message(const LiteralMessageSite& site) {
+    site.emit_message();
+  }
+
+  static void emit_message(const char* msg, size_t len) {
+    instrmt_tty_emit_message(msg, len);
+  }
+};
+
+} // namespace instrmt
+
+#endif // INSTRMTTTYPOLICY_HXX
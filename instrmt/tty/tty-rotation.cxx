@@ -0,0 +1,191 @@
+#include "tty-rotation.hxx"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// How often the background thread checks the size and age of the file.
+constexpr std::chrono::milliseconds poll_interval{100};
+
+std::uint64_t parse_number(const std::string& str, std::size_t& end) {
+  if (str.empty() || str[0] < '0' || str[0] > '9')
+    throw std::invalid_argument(str);
+  return std::stoull(str, &end);
+}
+
+// Gives back the blocks preallocated after the end of the file.
+void release_preallocation(int fd) {
+  struct stat st;
+  if (fstat(fd, &st) == 0)
+    (void)ftruncate(fd, st.st_size);
+}
+
+void preallocate(int fd, std::uint64_t size) {
+  // Best effort, not all filesystems support it.
+  if (size > 0)
+    (void)fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size));
+}
+
+} // anonymous namespace
+
+namespace instrmt {
+namespace tty {
+
+std::uint64_t parse_size(const std::string& str) {
+  try {
+    std::size_t end = 0;
+    std::uint64_t value = parse_number(str, end);
+    if (end + 1 == str.size()) {
+      switch (str[end]) {
+      case 'G': value *= 1024;
+      // fall through
+      case 'M': value *= 1024;
+      // fall through
+      case 'K': value *= 1024; break;
+      default: throw std::invalid_argument(str);
+      }
+    } else if (end != str.size()) {
+      throw std::invalid_argument(str);
+    }
+    return value;
+  } catch (const std::logic_error&) {
+    throw std::runtime_error("invalid size: " + str);
+  }
+}
+
+std::chrono::seconds parse_duration(const std::string& str) {
+  try {
+    std::size_t end = 0;
+    std::uint64_t value = parse_number(str, end);
+    if (end + 1 == str.size()) {
+      switch (str[end]) {
+      case 'd': value *= 24;
+      // fall through
+      case 'h': value *= 60;
+      // fall through
+      case 'm': value *= 60;
+      // fall through
+      case 's': break;
+      default: throw std::invalid_argument(str);
+      }
+    } else if (end != str.size()) {
+      throw std::invalid_argument(str);
+    }
+    return std::chrono::seconds(value);
+  } catch (const std::logic_error&) {
+    throw std::runtime_error("invalid duration: " + str);
+  }
+}
+
+unsigned int parse_count(const std::string& str) {
+  try {
+    std::size_t end = 0;
+    const std::uint64_t value = parse_number(str, end);
+    if (end != str.size() || value > std::numeric_limits<unsigned int>::max())
+      throw std::invalid_argument(str);
+    return static_cast<unsigned int>(value);
+  } catch (const std::logic_error&) {
+    throw std::runtime_error("invalid number of files: " + str);
+  }
+}
+
+Rotator::Rotator(FILE* file, std::string filename, RotationPolicy policy)
+  : file(file)
+  , filename(std::move(filename))
+  , next_filename(this->filename + ".next")
+  , policy(policy)
+  , opened(std::chrono::steady_clock::now())
+{
+  preallocate(fileno(file), policy.max_size);
+  prepare_next();
+  thread = std::thread(&Rotator::run, this);
+}
+
+Rotator::~Rotator() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  cv.notify_all();
+  thread.join();
+
+  if (next_fd >= 0) {
+    close(next_fd);
+    unlink(next_filename.c_str());
+  }
+
+  fflush(file);
+  release_preallocation(fileno(file));
+}
+
+void Rotator::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!cv.wait_for(lock, poll_interval, [this]{ return stopping; })) {
+    if (should_rotate())
+      rotate();
+  }
+}
+
+void Rotator::prepare_next() {
+  if (next_fd >= 0)
+    return;
+
+  next_fd = open(next_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0666);
+  if (next_fd >= 0)
+    preallocate(next_fd, policy.max_size);
+}
+
+bool Rotator::should_rotate() const {
+  if (policy.max_age.count() > 0 && std::chrono::steady_clock::now() - opened >= policy.max_age)
+    return true;
+
+  struct stat st;
+  return policy.max_size > 0
+      && fstat(fileno(file), &st) == 0
+      && static_cast<std::uint64_t>(st.st_size) >= policy.max_size;
+}
+
+void Rotator::rotate() {
+  // Retry on the next poll if the new file cannot be created yet.
+  prepare_next();
+  if (next_fd < 0)
+    return;
+
+  // Writers keep writing to the current file while it is renamed.
+  if (policy.keep > 0) {
+    unlink((filename + "." + std::to_string(policy.keep)).c_str());
+    for (unsigned int i = policy.keep - 1; i > 0; --i)
+      rename((filename + "." + std::to_string(i)).c_str(), (filename + "." + std::to_string(i + 1)).c_str());
+    rename(filename.c_str(), (filename + ".1").c_str());
+  } else {
+    unlink(filename.c_str());
+  }
+  rename(next_filename.c_str(), filename.c_str());
+
+  // Swap the file under the descriptor used by the FILE*.
+  // Writers are only held while the stdio buffer is flushed.
+  const int old_fd = dup(fileno(file));
+  flockfile(file);
+  fflush(file);
+  dup2(next_fd, fileno(file));
+  funlockfile(file);
+
+  close(next_fd);
+  next_fd = -1;
+
+  if (old_fd >= 0) {
+    release_preallocation(old_fd);
+    close(old_fd);
+  }
+
+  opened = std::chrono::steady_clock::now();
+  prepare_next();
+}
+
+} // namespace tty
+} // namespace instrmt
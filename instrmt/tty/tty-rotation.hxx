@@ -0,0 +1,65 @@
+#ifndef INSTRMTTTYROTATION_HXX
+#define INSTRMTTTYROTATION_HXX
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace instrmt {
+namespace tty {
+
+// Parses a size with an optional K, M or G suffix (e.g. "256M").
+std::uint64_t parse_size(const std::string& str);
+
+// Parses a duration with an optional s, m, h or d suffix (e.g. "12h").
+std::chrono::seconds parse_duration(const std::string& str);
+
+// Parses a number of files.
+unsigned int parse_count(const std::string& str);
+
+struct RotationPolicy {
+  std::uint64_t max_size = 0;
+  std::chrono::seconds max_age{0};
+  unsigned int keep = 5;
+};
+
+// Rotates a file from a background thread: when the file grows over max_size
+// or gets older than max_age, it is renamed to <filename>.1 (previous files
+// being shifted up to <filename>.<keep>), and a new, preallocated, file
+// replaces it under the same file descriptor.
+// Writers keep using the same FILE* and never wait for open() or rename().
+class Rotator {
+private:
+  FILE* file;
+  std::string filename;
+  std::string next_filename;
+  RotationPolicy policy;
+
+  int next_fd = -1;
+  std::chrono::steady_clock::time_point opened;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool stopping = false;
+  std::thread thread;
+
+  void run();
+  void prepare_next();
+  bool should_rotate() const;
+  void rotate();
+
+public:
+  Rotator(FILE* file, std::string filename, RotationPolicy policy);
+  Rotator(const Rotator&) = delete;
+  Rotator& operator=(const Rotator&) = delete;
+  ~Rotator();
+};
+
+} // namespace tty
+} // namespace instrmt
+
+#endif // INSTRMTTTYROTATION_HXX
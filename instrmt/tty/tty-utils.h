@@ -1,7 +1,9 @@
 #ifndef INSTRMTTTYUTILS_H
 #define INSTRMTTTYUTILS_H
 
+#include <stddef.h>
 #include <sys/time.h>
+#include <time.h>
 
 inline double instrmt_get_time_ms() {
   struct timeval time_s;
@@ -9,7 +11,14 @@ inline double instrmt_get_time_ms() {
   return time_s.tv_sec * 1000.0 + (time_s.tv_usec / 1000.0);
 }
 
-constexpr int instrmt_tty_string_color(const char* p) {
+inline double instrmt_get_cpu_time_ms() {
+  struct timespec time_s;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time_s);
+  return time_s.tv_sec * 1000.0 + (time_s.tv_nsec / 1000000.0);
+}
+
+// Hashes at most len characters of p, stops at the first NUL character.
+constexpr int instrmt_tty_string_color(const char* p, size_t len = (size_t)-1) {
   constexpr int num_colors = 14;
   const int colors[num_colors] = {
     31, // red
@@ -30,7 +39,7 @@ constexpr int instrmt_tty_string_color(const char* p) {
 
   unsigned long result = 0;
   const unsigned long prime = 31;
-  while(*p != 0)
+  while(len-- > 0 && *p != 0)
     result = *p++ + (result * prime);
   return colors[result % num_colors];
 }
@@ -1,62 +1,10 @@
 #ifndef INSTRMTTTYWRAPPER_HXX
 #define INSTRMTTTYWRAPPER_HXX
 
-#include <instrmt/tty/tty-utils.h>
+#include <instrmt/tty/tty-policy.hxx>
+#include <instrmt/details/format.hxx>
 #include <instrmt/details/utils.h>
 
-#include <stdio.h>
-
-struct InstrmtTTYRegionContext {
-  const char* name;
-  int color;
-};
-
-class InstrmtTTYRegion
-{
-private:
-  const struct InstrmtTTYRegionContext& ctx;
-  double start;
-  bool live = true;
-
-public:
-  explicit inline InstrmtTTYRegion(const struct InstrmtTTYRegionContext& ctx)
-    : ctx(ctx)
-    , start(instrmt_get_time_ms())
-  {}
-
-  inline void terminate() {
-    if (live) {
-      live = false;
-      fprintf(stderr, "\e[0;%dm%-40s \e[1;34m%.1f\e[0m ms\n", ctx.color, ctx.name, instrmt_get_time_ms() - start);
-    }
-  }
-
-  inline ~InstrmtTTYRegion() {
-    terminate();
-  }
-};
-
-class InstrmtTTYLiteralMessageContext {
-private:
-  const char* msg;
-  int color;
-
-public:
-  explicit InstrmtTTYLiteralMessageContext(const char* msg)
-    : msg(msg)
-    , color(instrmt_tty_string_color(msg))
-  {}
-
-  void emit_message() const {
-    fprintf(stderr, "\e[0;%dm%-40s\e[0m\n", color, msg);
-  }
-};
-
-inline void instrmt_tty_emit_message(const char* msg)
-{
-  fprintf(stderr, "\e[0;%dm%-40s\e[0m\n", instrmt_tty_string_color(msg), msg);
-}
-
 #define INSTRMT_NAMED_REGION(VAR, NAME) \
   static const struct InstrmtTTYRegionContext INSTRMTCONCAT(VAR, _instrmt_tty_region_ctx) = {NAME, instrmt_tty_string_color(NAME)}; \
   InstrmtTTYRegion INSTRMTCONCAT(VAR, _instrmt_tty_region)(INSTRMTCONCAT(VAR, _instrmt_tty_region_ctx))
@@ -71,7 +19,11 @@ inline void instrmt_tty_emit_message(const char* msg)
 
 #define INSTRMT_REGION_END() INSTRMT_NAMED_REGION_END(_)
 
+#ifdef INSTRMT_QUALIFIED_FUNCTION_NAMES
+#define INSTRMT_FUNCTION() INSTRMT_QUALIFIED_FUNCTION()
+#else
 #define INSTRMT_FUNCTION() INSTRMT_NAMED_REGION(_, __FUNCTION__)
+#endif
 
 #define INSTRMT_NAMED_LITERAL_MESSAGE(VAR, MSG) \
   static const InstrmtTTYLiteralMessageContext INSTRMTCONCAT(VAR, _instrmt_msg_ctx)(MSG); \
@@ -83,4 +35,13 @@ inline void instrmt_tty_emit_message(const char* msg)
 #define INSTRMT_MESSAGE(MSG) \
   instrmt_tty_emit_message(MSG)
 
+#define INSTRMT_MESSAGE_N(MSG, LEN) \
+  instrmt_tty_emit_message(MSG, LEN)
+
+#define INSTRMT_NAMED_MESSAGEF(VAR, ...) \
+  instrmt_tty_emit_message(::instrmt::format::now(__VA_ARGS__))
+
+#define INSTRMT_MESSAGEF(...) \
+  INSTRMT_NAMED_MESSAGEF(_, __VA_ARGS__)
+
 #endif // INSTRMTTTYWRAPPER_HXX
@@ -0,0 +1,28 @@
+# Runs `COMMAND SCENARIO N` with the TTY engine writing CSV to OUTPUT, and
+# checks that every region is written with COLUMNS columns.
+
+execute_process(COMMAND ${COMMAND} ${SCENARIO} ${N} RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "${COMMAND} failed: ${result}")
+endif()
+
+file(STRINGS ${OUTPUT} lines)
+set(regions 0)
+foreach(line ${lines})
+  # Messages only have a date and a text.
+  if (NOT line MATCHES "^[0-9.]+; [^;]+; [0-9.]+")
+    continue()
+  endif()
+
+  string(REGEX REPLACE "[^;]" "" separators "${line}")
+  string(LENGTH "${separators}" count)
+  math(EXPR count "${count} + 1")
+  if (NOT count EQUAL COLUMNS)
+    message(FATAL_ERROR "${count} columns instead of ${COLUMNS}: ${line}")
+  endif()
+  math(EXPR regions "${regions} + 1")
+endforeach()
+
+if (regions EQUAL 0)
+  message(FATAL_ERROR "No region written")
+endif()
@@ -0,0 +1,22 @@
+# Runs `REPORT INPUT` and checks that each regular expression of EXPECTED (one
+# per line) matches a line of its output.
+
+execute_process(COMMAND ${REPORT} ${INPUT} RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE log)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "${REPORT} failed: ${result}\n${log}")
+endif()
+
+string(REPLACE "\n" ";" lines "${output}")
+file(STRINGS ${EXPECTED} expected)
+foreach(regex ${expected})
+  set(found FALSE)
+  foreach(line ${lines})
+    if (line MATCHES "${regex}")
+      set(found TRUE)
+      break()
+    endif()
+  endforeach()
+  if (NOT found)
+    message(FATAL_ERROR "No line matches \"${regex}\":\n${output}")
+  endif()
+endforeach()
@@ -0,0 +1,29 @@
+# Runs `COMMAND phases N` with the TTY engine writing to OUTPUT, rotated with
+# INSTRMT_TTY_ROTATE_KEEP=2, and checks that 2 previous files are kept.
+
+file(GLOB previous ${OUTPUT}*)
+if (previous)
+  file(REMOVE ${previous})
+endif()
+
+execute_process(COMMAND ${COMMAND} phases ${N} RESULT_VARIABLE result ERROR_VARIABLE log)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "${COMMAND} failed: ${result}\n${log}")
+endif()
+
+foreach(file ${OUTPUT} ${OUTPUT}.1 ${OUTPUT}.2)
+  if (NOT EXISTS ${file})
+    message(FATAL_ERROR "${file} not found:\n${log}")
+  endif()
+endforeach()
+
+file(SIZE ${OUTPUT}.1 size)
+if (size EQUAL 0)
+  message(FATAL_ERROR "${OUTPUT}.1 is empty")
+endif()
+
+foreach(file ${OUTPUT}.3 ${OUTPUT}.next)
+  if (EXISTS ${file})
+    message(FATAL_ERROR "${file} should not exist")
+  endif()
+endforeach()
@@ -0,0 +1,32 @@
+# Runs `COMMAND trees N` with the TTY engine writing to OUTPUT, and checks that
+# each region tree is either recorded as a whole or not at all, and that only
+# some of them are.
+
+execute_process(COMMAND ${COMMAND} trees ${N} RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "${COMMAND} failed: ${result}")
+endif()
+
+file(STRINGS ${OUTPUT} lines)
+set(trees 0)
+set(children 0)
+foreach(line ${lines})
+  if (line MATCHES "^child ")
+    math(EXPR children "${children} + 1")
+  elseif (line MATCHES "^tree ")
+    if (NOT children EQUAL 2)
+      message(FATAL_ERROR "Incomplete tree: ${children} child regions recorded")
+    endif()
+    set(children 0)
+    math(EXPR trees "${trees} + 1")
+  endif()
+endforeach()
+
+if (NOT children EQUAL 0)
+  message(FATAL_ERROR "Child regions recorded without their tree")
+endif()
+
+if (trees EQUAL 0 OR trees EQUAL N)
+  message(FATAL_ERROR "${trees} trees recorded out of ${N}")
+endif()
+message(STATUS "${trees} trees recorded out of ${N}")
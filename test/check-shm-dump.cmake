@@ -0,0 +1,33 @@
+# Runs COMMAND (with ARGS) with the flight recorder of the shm engine dumping
+# to DUMP, checks that it dumped DUMP.1 for REASON and that its output matches
+# LOG (if any), then that REPORT reads a region named NAME from DUMP.1.
+# COMMAND is expected to fail when CRASH is set.
+
+file(GLOB previous ${DUMP}.*)
+if (previous)
+  file(REMOVE ${previous})
+endif()
+
+execute_process(COMMAND ${COMMAND} ${ARGS} RESULT_VARIABLE result ERROR_VARIABLE log)
+if (CRASH AND result EQUAL 0)
+  message(FATAL_ERROR "${COMMAND} did not crash\n${log}")
+elseif (NOT CRASH AND NOT result EQUAL 0)
+  message(FATAL_ERROR "${COMMAND} failed: ${result}\n${log}")
+endif()
+
+if (NOT EXISTS ${DUMP}.1 OR NOT log MATCHES "Dumped [0-9]+ events to [^\n]*\\.1 \\(${REASON}\\)")
+  message(FATAL_ERROR "${DUMP}.1 not dumped on ${REASON}:\n${log}")
+endif()
+
+if (DEFINED LOG AND NOT log MATCHES "${LOG}")
+  message(FATAL_ERROR "Output does not match \"${LOG}\":\n${log}")
+endif()
+
+execute_process(COMMAND ${REPORT} ${DUMP}.1 RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE errors)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "${REPORT} failed: ${result}\n${errors}")
+endif()
+
+if (NOT output MATCHES "(^|\n)${NAME} +[1-9]")
+  message(FATAL_ERROR "No region ${NAME} in ${DUMP}.1:\n${output}")
+endif()
@@ -0,0 +1,34 @@
+#!/bin/sh
+# Usage: check-shm-tail.sh SCENARIOS TAIL SCENARIO N NAME COUNT
+#
+# Runs `SCENARIOS SCENARIO N` with the shm engine, attaches TAIL to it, and
+# checks that TAIL prints COUNT regions named NAME and that no event is
+# dropped.
+
+set -u
+
+scenarios=$1 tail=$2 scenario=$3 n=$4 name=$5 count=$6
+out=$(mktemp)
+trap 'rm -f "$out" "$out.err"' EXIT
+
+"$scenarios" "$scenario" "$n" &
+app=$!
+
+# The segment is created by the first region.
+sleep 0.3
+"$tail" -i 10 "$app" > "$out" 2> "$out.err" &
+reader=$!
+
+wait "$app" || { echo "$scenarios failed"; exit 1; }
+wait "$reader" || { echo "$tail failed"; cat "$out.err"; exit 1; }
+
+if grep -q "dropped" "$out.err"; then
+  cat "$out.err"
+  exit 1
+fi
+
+found=$(grep -c " $name " "$out")
+if [ "$found" -ne "$count" ]; then
+  echo "$found regions $name instead of $count"
+  exit 1
+fi
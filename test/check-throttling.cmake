@@ -0,0 +1,12 @@
+# Runs `COMMAND phases N` with throttling enabled, and checks that the region
+# is throttled when it gets hot, then recorded again when it cools down.
+
+execute_process(COMMAND ${COMMAND} phases ${N} RESULT_VARIABLE result ERROR_VARIABLE log)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "${COMMAND} failed: ${result}\n${log}")
+endif()
+
+string(REGEX MATCH "(Throttling|Turning off) region phases.*Recording region phases again" match "${log}")
+if (NOT match)
+  message(FATAL_ERROR "Region not throttled then recorded again:\n${log}")
+endif()
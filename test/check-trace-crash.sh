@@ -0,0 +1,29 @@
+#!/bin/sh
+# Usage: check-trace-crash.sh SCENARIOS REPORT TRACE
+#
+# Runs the phases scenario of SCENARIOS with the trace engine writing to
+# TRACE, kills it mid-run, and checks that REPORT reads the regions recorded
+# before the kill.
+
+set -u
+
+scenarios=$1 report=$2 trace=$3
+out=$(mktemp)
+trap 'rm -f "$out"' EXIT
+rm -f "$trace"
+
+# The first phase lasts 5 s.
+INSTRMT_TRACE_OUT=$trace "$scenarios" phases 2000 &
+app=$!
+
+sleep 0.5
+kill -9 "$app"
+wait "$app"
+
+"$report" "$trace" > "$out" 2>&1 || { echo "$report failed"; cat "$out"; exit 1; }
+
+if ! grep -Eq "^phases +[1-9]" "$out"; then
+  echo "No region phases in the partial trace"
+  cat "$out"
+  exit 1
+fi
@@ -0,0 +1,78 @@
+#include <instrmt/details/compose.hxx>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Checks that composed regions begin in the order of the policies, end in
+// the reverse order, and end once.
+
+namespace {
+
+std::vector<std::string> events;
+
+template<int N>
+struct RecordingPolicy {
+  struct Site {
+    Site(const char*, const char*, const char*, int) {}
+  };
+
+  class Region {
+  private:
+    bool live = true;
+
+  public:
+    explicit Region(const Site&) {
+      events.push_back("begin " + std::to_string(N));
+    }
+
+    void terminate() {
+      if (live) {
+        live = false;
+        events.push_back("end " + std::to_string(N));
+      }
+    }
+
+    ~Region() {
+      terminate();
+    }
+  };
+};
+
+bool check(const std::vector<std::string>& expected) {
+  if (events == expected) {
+    events.clear();
+    return true;
+  }
+
+  std::cerr << "Unexpected events:";
+  for (const std::string& event : events)
+    std::cerr << " [" << event << "]";
+  std::cerr << std::endl;
+  events.clear();
+  return false;
+}
+
+} // anonymous namespace
+
+int main() {
+  typedef instrmt::site<RecordingPolicy<1>, RecordingPolicy<2>, RecordingPolicy<3>> site;
+  typedef instrmt::region<RecordingPolicy<1>, RecordingPolicy<2>, RecordingPolicy<3>> region;
+
+  static const site s("f", __FUNCTION__, __FILE__, __LINE__);
+  bool ok = true;
+
+  {
+    region r(s);
+  }
+  ok &= check({"begin 1", "begin 2", "begin 3", "end 3", "end 2", "end 1"});
+
+  {
+    region r(s);
+    r.terminate();
+    ok &= check({"begin 1", "begin 2", "begin 3", "end 3", "end 2", "end 1"});
+  }
+  ok &= check({});
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+#include <instrmt/instrmt.hxx>
+
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Workloads checked by the check-* scripts, selected by the first
+// argument. The second one is a number of iterations.
+
+namespace {
+
+// Region trees of 3 regions.
+void trees(int n) {
+  for (int i = 0; i < n; ++i) {
+    INSTRMT_REGION("tree");
+    for (int j = 0; j < 2; ++j) {
+      INSTRMT_REGION("child");
+    }
+  }
+}
+
+// Regions ending in another order than they began.
+void overlap(int n) {
+  for (int i = 0; i < n; ++i) {
+    INSTRMT_NAMED_REGION_BEGIN(a, "a");
+    INSTRMT_NAMED_REGION_BEGIN(b, "b");
+    INSTRMT_NAMED_REGION_END(a);
+    INSTRMT_NAMED_REGION_BEGIN(c, "c");
+    INSTRMT_NAMED_REGION_END(b);
+    INSTRMT_NAMED_REGION_END(c);
+  }
+}
+
+// Region trees in several threads.
+void threads(int n) {
+  std::vector<std::thread> workers;
+  for (int i = 0; i < n; ++i)
+    workers.emplace_back([]() { trees(10); });
+  for (auto& worker : workers)
+    worker.join();
+}
+
+// Empty regions of a single site, called concurrently by 8 threads.
+void contended(int n) {
+  std::vector<std::thread> workers;
+  for (int i = 0; i < 8; ++i) {
+    workers.emplace_back([n]() {
+      for (int j = 0; j < n; ++j) {
+        INSTRMT_REGION("contended");
+      }
+    });
+  }
+  for (auto& worker : workers)
+    worker.join();
+}
+
+// Region trees in threads started one after the other.
+void churn(int n) {
+  for (int i = 0; i < n; ++i) {
+    std::thread([]() {
+      trees(10);
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }).join();
+  }
+}
+
+// Storms of a literal message, then of a dynamic message in a thread that
+// exits.
+void storm(int n) {
+  for (int i = 0; i < n; ++i) {
+    INSTRMT_LITERAL_MESSAGE("literal storm");
+  }
+  std::thread([n]() {
+    const std::string msg = "dynamic storm";
+    for (int i = 0; i < n; ++i) {
+      INSTRMT_MESSAGE(msg.c_str());
+    }
+  }).join();
+}
+
+// Storms, then a pause longer than the window of the summaries.
+void storms(int n) {
+  storm(n);
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+  std::cerr << "Storms over" << std::endl;
+}
+
+// Messages that do not fit in a single event of the binary engines.
+void long_messages(int n) {
+  const std::string text = "long dynamic message " + std::string(static_cast<std::size_t>(n), '-') + " end";
+  INSTRMT_MESSAGE(text.c_str());
+  INSTRMT_MESSAGEF("long formatted message %d %s %d", n, std::string(static_cast<std::size_t>(n), '-').c_str(), -n);
+  const std::string huge = "huge dynamic message " + std::string(2000, '-');
+  INSTRMT_MESSAGE(huge.c_str());
+}
+
+// Recurses until the stack overflows.
+int recurse(int depth) {
+  volatile char frame[1024];
+  frame[0] = static_cast<char>(depth);
+  if (depth <= 0)
+    return 0;
+  return recurse(depth + 1) + frame[0];
+}
+
+// Region trees, then a stack overflow.
+void overflow(int n) {
+  trees(n);
+  std::cerr << recurse(1) << std::endl;
+}
+
+volatile std::sig_atomic_t signaled = 0;
+
+// Region trees, then SIGUSR1, with a handler installed before the engine.
+void signal(int n) {
+  std::signal(SIGUSR1, [](int) { signaled = 1; });
+  trees(n);
+  std::raise(SIGUSR1);
+  if (signaled)
+    std::cerr << "SIGUSR1 received by the application" << std::endl;
+}
+
+// Empty regions of a single site, separated by pauses.
+void calls(int n, std::chrono::microseconds pause) {
+  for (int i = 0; i < n; ++i) {
+    {
+      INSTRMT_REGION("phases");
+    }
+    if (pause.count() > 0)
+      std::this_thread::sleep_for(pause);
+  }
+}
+
+// A region called slowly, then in a tight loop, then slowly again.
+void phases(int n) {
+  calls(n / 2, std::chrono::milliseconds(5));
+  calls(100000, std::chrono::microseconds(0));
+  calls(n, std::chrono::milliseconds(5));
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " SCENARIO [N]" << std::endl;
+    return 1;
+  }
+
+  const char* scenario = argv[1];
+  const int n = argc > 2 ? std::atoi(argv[2]) : 1;
+
+  if (std::strcmp(scenario, "trees") == 0) {
+    trees(n);
+  } else if (std::strcmp(scenario, "overlap") == 0) {
+    overlap(n);
+  } else if (std::strcmp(scenario, "threads") == 0) {
+    threads(n);
+  } else if (std::strcmp(scenario, "contended") == 0) {
+    contended(n);
+  } else if (std::strcmp(scenario, "churn") == 0) {
+    churn(n);
+  } else if (std::strcmp(scenario, "storm") == 0) {
+    storm(n);
+  } else if (std::strcmp(scenario, "storms") == 0) {
+    storms(n);
+  } else if (std::strcmp(scenario, "long") == 0) {
+    long_messages(n);
+  } else if (std::strcmp(scenario, "overflow") == 0) {
+    overflow(n);
+  } else if (std::strcmp(scenario, "signal") == 0) {
+    signal(n);
+  } else if (std::strcmp(scenario, "phases") == 0) {
+    phases(n);
+  } else {
+    std::cerr << "Unknown scenario: " << scenario << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,633 @@
+#include <instrmt/details/format.hxx>
+#include <instrmt/details/trace-format.hxx>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+void usage(FILE* out) {
+  fprintf(out,
+          "Usage: instrmt-report [-n N] [-m N] [-j JOBS] FILE...\n"
+          "\n"
+          "Summarize tty csv outputs (INSTRMT_TTY_FORMAT=csv) and binary traces (instrmt-tail -o).\n"
+          "\n"
+          "  -n N     Number of slowest region instances to print (default: 10).\n"
+          "  -m N     Number of last messages to print (default: 10).\n"
+          "  -j JOBS  Number of parsing threads (default: number of cores).\n"
+          "  -h       Print this help.\n");
+}
+
+// Points into the mapped input, names are never copied.
+struct Name {
+  const char* data;
+  std::size_t size;
+
+  bool operator==(const Name& other) const {
+    return size == other.size && std::memcmp(data, other.data, size) == 0;
+  }
+};
+
+struct NameHash {
+  std::size_t operator()(const Name& name) const {
+    // FNV-1a
+    std::uint64_t h = 14695981039346656037ull;
+    for (std::size_t i = 0; i < name.size; ++i)
+      h = (h ^ static_cast<unsigned char>(name.data[i])) * 1099511628211ull;
+    return static_cast<std::size_t>(h);
+  }
+};
+
+// Log-linear histogram: 32 buckets per power of two, ~3% precision.
+class Histogram {
+private:
+  static constexpr int sub_bits = 5;
+
+  std::vector<std::uint64_t> counts;
+  std::size_t offset = 0;
+
+  static std::size_t bucket(std::uint64_t v) {
+    if (v < (1u << sub_bits))
+      return static_cast<std::size_t>(v);
+    const int msb = 63 - __builtin_clzll(v);
+    const int shift = msb - sub_bits;
+    return (static_cast<std::size_t>(shift + 1) << sub_bits) + ((v >> shift) & ((1u << sub_bits) - 1));
+  }
+
+  static std::uint64_t value(std::size_t b) {
+    const int shift = static_cast<int>(b >> sub_bits) - 1;
+    if (shift <= 0)
+      return b;
+    const std::uint64_t lower = static_cast<std::uint64_t>((b & ((1u << sub_bits) - 1)) | (1u << sub_bits)) << shift;
+    return lower + (std::uint64_t(1) << shift) / 2;
+  }
+
+  void add(std::size_t b, std::uint64_t n) {
+    if (counts.empty()) {
+      offset = b;
+      counts.resize(1);
+    } else if (b < offset) {
+      counts.insert(counts.begin(), offset - b, 0);
+      offset = b;
+    } else if (b >= offset + counts.size()) {
+      counts.resize(b - offset + 1);
+    }
+    counts[b - offset] += n;
+  }
+
+public:
+  void add(std::uint64_t v) {
+    add(bucket(v), 1);
+  }
+
+  void merge(const Histogram& other) {
+    for (std::size_t i = 0; i < other.counts.size(); ++i)
+      if (other.counts[i])
+        add(other.offset + i, other.counts[i]);
+  }
+
+  std::uint64_t percentile(double p, std::uint64_t total) const {
+    const std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(p * total)));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+      seen += counts[i];
+      if (seen >= rank)
+        return value(offset + i);
+    }
+    return 0;
+  }
+};
+
+struct RegionStats {
+  std::uint64_t count = 0;
+  std::uint64_t total = 0;
+  std::uint64_t max = 0;
+  Histogram histogram;
+
+  void add(std::uint64_t duration) {
+    ++count;
+    total += duration;
+    max = std::max(max, duration);
+    histogram.add(duration);
+  }
+
+  void merge(const RegionStats& other) {
+    count += other.count;
+    total += other.total;
+    max = std::max(max, other.max);
+    histogram.merge(other.histogram);
+  }
+};
+
+struct Instance {
+  std::uint64_t duration;
+  std::uint64_t start;
+  Name name;
+  std::uint32_t tid;
+  bool has_tid;
+
+  bool operator>(const Instance& other) const {
+    return duration > other.duration;
+  }
+};
+
+struct Message {
+  std::uint64_t time;
+  std::string text;
+  std::uint32_t tid;
+  bool has_tid;
+};
+
+struct ThreadStats {
+  std::uint64_t busy = 0;
+  std::uint64_t first = UINT64_MAX;
+  std::uint64_t last = 0;
+
+  void merge(const ThreadStats& other) {
+    busy += other.busy;
+    first = std::min(first, other.first);
+    last = std::max(last, other.last);
+  }
+};
+
+// Results of a parsing job, merged once all the jobs are done.
+struct Report {
+  std::size_t top_count;
+  std::unordered_map<Name, RegionStats, NameHash> regions;
+  std::priority_queue<Instance, std::vector<Instance>, std::greater<Instance>> slowest;
+  std::unordered_map<std::uint32_t, ThreadStats> threads;
+  std::vector<Message> messages;
+  std::size_t skipped = 0; // Lines of csv files that could not be parsed.
+
+  explicit Report(std::size_t top_count)
+    : top_count(top_count)
+  {}
+
+  void add_instance(const Instance& instance) {
+    if (slowest.size() < top_count) {
+      slowest.push(instance);
+    } else if (top_count > 0 && instance.duration > slowest.top().duration) {
+      slowest.pop();
+      slowest.push(instance);
+    }
+  }
+
+  void add(Name name, std::uint64_t start, std::uint64_t duration) {
+    regions[name].add(duration);
+    add_instance({duration, start, name, 0, false});
+  }
+
+  void add(Name name, std::uint64_t start, std::uint64_t duration, std::uint32_t tid, unsigned depth) {
+    regions[name].add(duration);
+    add_instance({duration, start, name, tid, true});
+
+    ThreadStats& thread = threads[tid];
+    if (depth == 0)
+      thread.busy += duration;
+    thread.first = std::min(thread.first, start);
+    thread.last = std::max(thread.last, start + duration);
+  }
+
+  void add_message(std::uint64_t time, std::string text) {
+    messages.push_back({time, std::move(text), 0, false});
+  }
+
+  void add_message(std::uint64_t time, std::string text, std::uint32_t tid) {
+    messages.push_back({time, std::move(text), tid, true});
+  }
+
+  void merge(Report& other) {
+    for (const auto& region : other.regions)
+      regions[region.first].merge(region.second);
+
+    while (!other.slowest.empty()) {
+      add_instance(other.slowest.top());
+      other.slowest.pop();
+    }
+
+    for (const auto& thread : other.threads)
+      threads[thread.first].merge(thread.second);
+
+    for (Message& message : other.messages)
+      messages.push_back(std::move(message));
+    other.messages.clear();
+
+    skipped += other.skipped;
+  }
+};
+
+class MappedFile {
+public:
+  const char* data = nullptr;
+  std::size_t size = 0;
+
+  explicit MappedFile(const std::string& filename) {
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("unable to open " + filename + " (" + std::strerror(errno) + ")");
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      throw std::runtime_error("unable to stat " + filename + " (" + std::strerror(errno) + ")");
+    }
+
+    size = static_cast<std::size_t>(st.st_size);
+    if (size > 0) {
+      void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("unable to map " + filename + " (" + std::strerror(errno) + ")");
+      }
+      // The file is read once, from start to end, by each job.
+      madvise(addr, size, MADV_SEQUENTIAL);
+      data = static_cast<const char*>(addr);
+    }
+    close(fd);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    if (data)
+      munmap(const_cast<char*>(data), size);
+  }
+};
+
+template<typename Job>
+void run_jobs(std::size_t jobs, std::vector<Report>& reports, Job job) {
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < jobs; ++i)
+    threads.emplace_back(job, i, std::ref(reports[i]));
+  job(0, reports[0]);
+  for (std::thread& t : threads)
+    t.join();
+}
+
+// Parses a decimal number of milliseconds into nanoseconds.
+// Returns false if there is no number at p.
+bool parse_ms(const char*& p, const char* end, std::uint64_t& ns) {
+  while (p < end && *p == ' ')
+    ++p;
+
+  const char* begin = p;
+  std::uint64_t integer = 0;
+  while (p < end && *p >= '0' && *p <= '9')
+    integer = integer * 10 + static_cast<std::uint64_t>(*p++ - '0');
+
+  std::uint64_t fraction = 0, scale = 1000000;
+  if (p < end && *p == '.') {
+    ++p;
+    while (p < end && *p >= '0' && *p <= '9') {
+      if (scale > 1) {
+        scale /= 10;
+        fraction += static_cast<std::uint64_t>(*p - '0') * scale;
+      }
+      ++p;
+    }
+  }
+
+  ns = integer * 1000000 + fraction;
+  return p != begin;
+}
+
+// Lines are "start; name; duration[; extra columns...]", messages are "time; message".
+// Messages containing "; " cannot be told apart from malformed regions.
+// Returns false if the line cannot be parsed.
+bool parse_csv_line(const char* p, const char* end, Report& report) {
+  std::uint64_t start, duration;
+  if (!parse_ms(p, end, start) || end - p < 2 || p[0] != ';' || p[1] != ' ')
+    return false;
+  p += 2;
+
+  const char* name = p;
+  const char* name_end = nullptr;
+  for (const char* q = p; q + 1 < end; ++q) {
+    if (q[0] == ';' && q[1] == ' ') {
+      name_end = q;
+      break;
+    }
+  }
+  if (name_end == nullptr) {
+    report.add_message(start, std::string(p, end));
+    return true;
+  }
+
+  p = name_end + 2;
+  if (!parse_ms(p, end, duration))
+    return false;
+
+  report.add({name, static_cast<std::size_t>(name_end - name)}, start, duration);
+  return true;
+}
+
+void parse_csv(const MappedFile& file, std::vector<Report>& reports) {
+  const std::size_t jobs = reports.size();
+  const char* data = file.data;
+  const char* const data_end = data + file.size;
+
+  // Chunks start right after a newline, and end right after one.
+  std::vector<const char*> bounds(jobs + 1, data_end);
+  bounds[0] = data;
+  for (std::size_t i = 1; i < jobs; ++i) {
+    const char* p = std::max(bounds[i - 1], data + file.size / jobs * i);
+    const void* nl = p < data_end ? std::memchr(p, '\n', static_cast<std::size_t>(data_end - p)) : nullptr;
+    bounds[i] = nl ? static_cast<const char*>(nl) + 1 : data_end;
+  }
+
+  run_jobs(jobs, reports, [&](std::size_t job, Report& report) {
+    const char* p = bounds[job];
+    const char* const end = bounds[job + 1];
+    while (p < end) {
+      const void* nl = std::memchr(p, '\n', static_cast<std::size_t>(end - p));
+      const char* line_end = nl ? static_cast<const char*>(nl) : end;
+      if (line_end != p && !parse_csv_line(p, line_end, report))
+        ++report.skipped;
+      p = line_end + 1;
+    }
+  });
+}
+
+void parse_binary(const MappedFile& file, std::vector<Report>& reports) {
+  using namespace instrmt::trace;
+
+  struct Range {
+    const Event* events;
+    std::size_t count;
+  };
+
+  std::vector<Name> sites;
+  std::vector<const Site*> site_items; // Format strings and types of formatted messages.
+  std::vector<Range> ranges;
+  std::size_t total = 0;
+
+  // Index the blocks. Blocks may be truncated when the trace was not closed properly.
+  std::size_t offset = sizeof(FileHeader);
+  while (offset + sizeof(BlockHeader) <= file.size) {
+    const auto* block = reinterpret_cast<const BlockHeader*>(file.data + offset);
+    offset += sizeof(BlockHeader);
+
+    if (block->item_size == 0)
+      break;
+
+    const std::size_t available = (file.size - offset) / block->item_size;
+    const std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(
+      std::min<std::uint64_t>(block->count.load(std::memory_order_acquire), block->capacity), available));
+
+    if (block->type == static_cast<std::uint32_t>(BlockType::sites) && block->item_size == sizeof(Site)) {
+      const auto* items = reinterpret_cast<const Site*>(file.data + offset);
+      if (sites.size() < block->first + count) {
+        sites.resize(static_cast<std::size_t>(block->first + count), Name{"<unknown>", 9});
+        site_items.resize(sites.size(), nullptr);
+      }
+      for (std::size_t i = 0; i < count; ++i) {
+        sites[static_cast<std::size_t>(block->first) + i] = {items[i].name, strnlen(items[i].name, sizeof(items[i].name))};
+        site_items[static_cast<std::size_t>(block->first) + i] = &items[i];
+      }
+    } else if (block->type == static_cast<std::uint32_t>(BlockType::events) && block->item_size == sizeof(Event)) {
+      ranges.push_back({reinterpret_cast<const Event*>(file.data + offset), count});
+      total += count;
+    }
+
+    if (block->capacity > available)
+      break;
+    offset += static_cast<std::size_t>(block->capacity) * block->item_size;
+  }
+
+  const std::size_t jobs = reports.size();
+  run_jobs(jobs, reports, [&](std::size_t job, Report& report) {
+    // Each job handles a contiguous slice of all the events.
+    std::size_t first = total / jobs * job;
+    std::size_t last = job + 1 == jobs ? total : total / jobs * (job + 1);
+
+    for (const Range& range : ranges) {
+      if (first >= range.count) {
+        first -= range.count;
+        last -= range.count;
+        continue;
+      }
+
+      for (std::size_t i = first; i < std::min(last, range.count); ++i) {
+        const Event& event = range.events[i];
+        const Name name = event.site < sites.size() ? sites[event.site] : Name{"<unknown>", 9};
+        switch (static_cast<EventKind>(event.kind)) {
+        case EventKind::region:
+          report.add(name, event.time, event.duration, event.tid, event.depth);
+          break;
+        case EventKind::literal_message:
+          report.add_message(event.time, std::string(name.data, name.size), event.tid);
+          break;
+        case EventKind::message: {
+          // Continuations may extend past the slice of the job.
+          std::string text;
+          if (!instrmt::trace::load_text(&event, range.events + range.count, text))
+            text += "...";
+          report.add_message(event.time, std::move(text), event.tid);
+          break;
+        }
+        case EventKind::formatted_message: {
+          const Site* site = event.site < site_items.size() ? site_items[event.site] : nullptr;
+          if (site == nullptr) {
+            report.add_message(event.time, "<unknown>", event.tid);
+            break;
+          }
+          char types[sizeof(site->types) + 1] = {};
+          std::memcpy(types, site->types, sizeof(site->types));
+          std::string args;
+          const bool complete = instrmt::trace::load_text(&event, range.events + range.count, args);
+          std::string text = instrmt::format::format(site->name, types, args.data(), args.size());
+          if (!complete)
+            text += "...";
+          report.add_message(event.time, std::move(text), event.tid);
+          break;
+        }
+        case EventKind::continuation:
+          break;
+        }
+      }
+
+      if (last <= range.count)
+        break;
+      first = 0;
+      last -= range.count;
+    }
+  });
+}
+
+// Traces of another version are rejected rather than read as csv files.
+bool is_binary(const MappedFile& file, const std::string& filename) {
+  if (file.size < sizeof(instrmt::trace::FileHeader)
+      || std::memcmp(file.data, instrmt::trace::file_magic, sizeof(instrmt::trace::file_magic)) != 0)
+    return false;
+
+  const auto* header = reinterpret_cast<const instrmt::trace::FileHeader*>(file.data);
+  if (header->version != instrmt::trace::file_version)
+    throw std::runtime_error("unsupported trace version " + std::to_string(header->version) + " in " + filename
+                             + " (expected " + std::to_string(instrmt::trace::file_version) + ")");
+  return true;
+}
+
+double ms(std::uint64_t ns) {
+  return static_cast<double>(ns) / 1e6;
+}
+
+void print(Report& report, std::size_t message_count) {
+  std::vector<std::pair<Name, const RegionStats*>> regions;
+  for (const auto& region : report.regions)
+    regions.emplace_back(region.first, &region.second);
+  std::sort(regions.begin(), regions.end(), [](const std::pair<Name, const RegionStats*>& a,
+                                               const std::pair<Name, const RegionStats*>& b) {
+    return a.second->total > b.second->total;
+  });
+
+  printf("%-40s %10s %14s %12s %12s %12s %12s %12s\n",
+         "Region", "Count", "Total (ms)", "Mean (ms)", "p50 (ms)", "p90 (ms)", "p99 (ms)", "Max (ms)");
+  for (const auto& region : regions) {
+    const RegionStats& stats = *region.second;
+    printf("%-40.*s %10llu %14.3f %12.3f %12.3f %12.3f %12.3f %12.3f\n",
+           static_cast<int>(region.first.size), region.first.data,
+           static_cast<unsigned long long>(stats.count),
+           ms(stats.total),
+           ms(stats.total) / static_cast<double>(stats.count),
+           ms(stats.histogram.percentile(0.50, stats.count)),
+           ms(stats.histogram.percentile(0.90, stats.count)),
+           ms(stats.histogram.percentile(0.99, stats.count)),
+           ms(stats.max));
+  }
+
+  std::vector<Instance> slowest;
+  while (!report.slowest.empty()) {
+    slowest.push_back(report.slowest.top());
+    report.slowest.pop();
+  }
+  std::reverse(slowest.begin(), slowest.end());
+
+  if (!slowest.empty()) {
+    printf("\nSlowest instances:\n");
+    for (const Instance& instance : slowest) {
+      if (instance.has_tid)
+        printf("  %-40.*s %12.3f ms  (start %.3f ms, thread %u)\n",
+               static_cast<int>(instance.name.size), instance.name.data,
+               ms(instance.duration), ms(instance.start), instance.tid);
+      else
+        printf("  %-40.*s %12.3f ms  (start %.3f ms)\n",
+               static_cast<int>(instance.name.size), instance.name.data,
+               ms(instance.duration), ms(instance.start));
+    }
+  }
+
+  if (!report.threads.empty()) {
+    std::vector<std::pair<std::uint32_t, ThreadStats>> threads(report.threads.begin(), report.threads.end());
+    std::sort(threads.begin(), threads.end(), [](const std::pair<std::uint32_t, ThreadStats>& a,
+                                                 const std::pair<std::uint32_t, ThreadStats>& b) {
+      return a.first < b.first;
+    });
+
+    printf("\n%-10s %14s %14s %12s\n", "Thread", "Busy (ms)", "Span (ms)", "Utilization");
+    for (const auto& thread : threads) {
+      const ThreadStats& stats = thread.second;
+      const std::uint64_t span = stats.last > stats.first ? stats.last - stats.first : 0;
+      printf("%-10u %14.3f %14.3f %11.1f%%\n", thread.first, ms(stats.busy), ms(span),
+             span ? 100.0 * static_cast<double>(stats.busy) / static_cast<double>(span) : 0.0);
+    }
+  }
+
+  std::vector<Message>& messages = report.messages;
+  if (!messages.empty() && message_count > 0) {
+    std::stable_sort(messages.begin(), messages.end(), [](const Message& a, const Message& b) {
+      return a.time < b.time;
+    });
+
+    printf("\nLast messages:\n");
+    for (std::size_t i = messages.size() - std::min(message_count, messages.size()); i < messages.size(); ++i) {
+      const Message& message = messages[i];
+      if (message.has_tid)
+        printf("  %12.3f ms  %s  (thread %u)\n", ms(message.time), message.text.c_str(), message.tid);
+      else
+        printf("  %12.3f ms  %s\n", ms(message.time), message.text.c_str());
+    }
+  }
+
+  if (report.skipped > 0)
+    printf("\nSkipped %zu lines that could not be parsed (messages containing \"; \" included).\n", report.skipped);
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+  std::size_t top_count = 10;
+  std::size_t message_count = 10;
+  std::size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:m:j:h")) != -1) {
+    switch (opt) {
+    case 'n':
+      top_count = std::strtoul(optarg, nullptr, 10);
+      break;
+    case 'm':
+      message_count = std::strtoul(optarg, nullptr, 10);
+      break;
+    case 'j':
+      jobs = std::max(1ul, std::strtoul(optarg, nullptr, 10));
+      break;
+    case 'h':
+      usage(stdout);
+      return EXIT_SUCCESS;
+    default:
+      usage(stderr);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (optind >= argc) {
+    usage(stderr);
+    return EXIT_FAILURE;
+  }
+
+  try {
+    // Names point into the mapped files, keep them until the report is printed.
+    std::vector<std::unique_ptr<MappedFile>> files;
+    Report report(top_count);
+
+    for (int i = optind; i < argc; ++i) {
+      files.emplace_back(new MappedFile(argv[i]));
+      const MappedFile& file = *files.back();
+
+      std::vector<Report> reports(jobs, Report(top_count));
+      if (is_binary(file, argv[i]))
+        parse_binary(file, reports);
+      else
+        parse_csv(file, reports);
+
+      for (Report& partial : reports)
+        report.merge(partial);
+    }
+
+    print(report, message_count);
+  } catch (const std::exception& ex) {
+    fprintf(stderr, "[INSTRMT/REPORT] %s\n", ex.what());
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
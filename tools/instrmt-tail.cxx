@@ -0,0 +1,353 @@
+#include <instrmt/details/format.hxx>
+#include <instrmt/details/trace-format.hxx>
+#include <instrmt/shm/shm-ring.hxx>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using instrmt::trace::Event;
+using instrmt::trace::EventKind;
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void on_signal(int) {
+  stop_requested = 1;
+}
+
+void usage(FILE* out) {
+  fprintf(out,
+          "Usage: instrmt-tail [-o FILE] [-i MS] PID\n"
+          "\n"
+          "Attach to the events published by the shm engine of process PID.\n"
+          "\n"
+          "  -o FILE  Save the events to a binary trace file instead of printing them.\n"
+          "  -i MS    Polling interval, in milliseconds (default: 100).\n"
+          "  -h       Print this help.\n");
+}
+
+class Ring {
+private:
+  void* addr = MAP_FAILED;
+  std::size_t size = 0;
+
+public:
+  const instrmt::shm::RingHeader* header = nullptr;
+
+  explicit Ring(unsigned long pid) {
+    const std::string name = instrmt::shm::segment_name(pid);
+
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+      throw std::runtime_error("unable to open /dev/shm" + name + " (" + std::strerror(errno) + ")");
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(instrmt::shm::RingHeader)) {
+      close(fd);
+      throw std::runtime_error("invalid segment /dev/shm" + name);
+    }
+
+    size = static_cast<std::size_t>(st.st_size);
+    addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+      throw std::runtime_error("unable to map /dev/shm" + name + " (" + std::strerror(errno) + ")");
+
+    header = static_cast<const instrmt::shm::RingHeader*>(addr);
+    if (std::memcmp(header->magic, instrmt::shm::ring_magic, sizeof(header->magic)) != 0
+        || header->version != instrmt::shm::ring_version
+        || instrmt::shm::segment_size(header->max_sites, header->lane_count, header->lane_capacity) > size) {
+      munmap(addr, size);
+      throw std::runtime_error("/dev/shm" + name + " is not a supported instrmt segment");
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+
+  Ring(const Ring&) = delete;
+  Ring& operator=(const Ring&) = delete;
+
+  ~Ring() {
+    if (addr != MAP_FAILED)
+      munmap(addr, size);
+  }
+
+  // Returns nullptr if the site is not (yet) available.
+  const instrmt::trace::Site* site(std::uint32_t id) const {
+    if (id >= header->max_sites)
+      return nullptr;
+    const instrmt::shm::SiteSlot& slot = instrmt::shm::sites(header)[id];
+    return slot.ready.load(std::memory_order_acquire) ? &slot.site : nullptr;
+  }
+};
+
+class Reader {
+private:
+  const Ring& ring;
+  std::vector<std::uint64_t> cursors;
+
+public:
+  std::uint64_t lost = 0;
+
+  explicit Reader(const Ring& ring)
+    : ring(ring)
+    , cursors(ring.header->lane_count)
+  {
+    // Start with the events that are still in the lanes.
+    const std::uint64_t capacity = ring.header->lane_capacity;
+    for (std::uint32_t i = 0; i < ring.header->lane_count; ++i) {
+      const std::uint64_t head = instrmt::shm::lane(ring.header, i)->head.load(std::memory_order_acquire);
+      cursors[i] = head > capacity ? head - capacity : 0;
+    }
+  }
+
+  // Appends the new events of every lane to `out`.
+  void poll(std::vector<Event>& out) {
+    const std::uint64_t capacity = ring.header->lane_capacity;
+
+    for (std::uint32_t i = 0; i < ring.header->lane_count; ++i) {
+      const instrmt::shm::LaneHeader* lane = instrmt::shm::lane(ring.header, i);
+      const Event* events = instrmt::shm::events(lane);
+      std::uint64_t& cursor = cursors[i];
+
+      const std::uint64_t head = lane->head.load(std::memory_order_acquire);
+      if (head - cursor > capacity) {
+        lost += head - capacity - cursor;
+        cursor = head - capacity;
+      }
+
+      const std::size_t first = out.size();
+      for (std::uint64_t e = cursor; e < head; ++e)
+        out.push_back(events[e & (capacity - 1)]);
+
+      // Discard the events the writer wrapped over while they were copied.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const std::uint64_t new_head = lane->head.load(std::memory_order_relaxed);
+      const std::uint64_t valid_from = new_head >= capacity ? new_head - capacity + 1 : 0;
+      if (cursor < valid_from) {
+        const std::uint64_t overwritten = std::min(valid_from, head) - cursor;
+        lost += overwritten;
+        out.erase(out.begin() + static_cast<std::ptrdiff_t>(first),
+                  out.begin() + static_cast<std::ptrdiff_t>(first + overwritten));
+      }
+
+      cursor = head;
+    }
+  }
+};
+
+class Printer {
+private:
+  const Ring& ring;
+
+public:
+  explicit Printer(const Ring& ring)
+    : ring(ring)
+  {}
+
+  void write(const std::vector<Event>& events) {
+    std::string text;
+    for (const Event* it = events.data(), *end = it + events.size(); it != end; ++it) {
+      const Event& event = *it;
+      const int indent = 2 * event.depth;
+      const instrmt::trace::Site* site = ring.site(event.site);
+      const char* name = site ? site->name : "<unknown>";
+
+      switch (static_cast<EventKind>(event.kind)) {
+      case EventKind::region:
+        printf("%-8u %*s%-40s %.3f ms\n", event.tid, indent, "", name, event.duration / 1e6);
+        break;
+      case EventKind::literal_message:
+        printf("%-8u %*s%s\n", event.tid, indent, "", name);
+        break;
+      case EventKind::message: {
+        const bool complete = instrmt::trace::load_text(it, end, text);
+        printf("%-8u %*s%.*s%s\n", event.tid, indent, "", static_cast<int>(text.size()), text.data(), complete ? "" : "...");
+        break;
+      }
+      case EventKind::formatted_message: {
+        if (site == nullptr) {
+          printf("%-8u %*s<unknown>\n", event.tid, indent, "");
+          break;
+        }
+        char types[sizeof(site->types) + 1] = {};
+        std::memcpy(types, site->types, sizeof(site->types));
+        const bool complete = instrmt::trace::load_text(it, end, text);
+        printf("%-8u %*s%s%s\n", event.tid, indent, "",
+               instrmt::format::format(site->name, types, text.data(), text.size()).c_str(), complete ? "" : "...");
+        break;
+      }
+      case EventKind::continuation:
+        // Read along with their message, or left over from a message the writer wrapped over.
+        break;
+      }
+    }
+    fflush(stdout);
+  }
+};
+
+class Recorder {
+private:
+  const Ring& ring;
+  FILE* file;
+  std::uint32_t saved_sites = 0;
+
+  void write_block(instrmt::trace::BlockType type, std::uint32_t item_size, std::uint64_t count, std::uint64_t first, const void* items) {
+    instrmt::trace::BlockHeader block{};
+    block.type = static_cast<std::uint32_t>(type);
+    block.item_size = item_size;
+    block.capacity = count;
+    block.count.store(count, std::memory_order_relaxed);
+    block.first = first;
+
+    if (fwrite(&block, sizeof(block), 1, file) != 1 || fwrite(items, item_size, count, file) != count)
+      throw std::runtime_error(std::string("unable to write trace (") + std::strerror(errno) + ")");
+  }
+
+  void save_sites() {
+    const std::uint32_t available = std::min(ring.header->site_count.load(std::memory_order_acquire), ring.header->max_sites);
+
+    std::vector<instrmt::trace::Site> sites;
+    for (std::uint32_t id = saved_sites; id < available; ++id) {
+      const instrmt::trace::Site* site = ring.site(id);
+      // Sites are saved in order, wait for this one to be published.
+      if (site == nullptr)
+        break;
+      sites.push_back(*site);
+    }
+
+    if (!sites.empty()) {
+      write_block(instrmt::trace::BlockType::sites, sizeof(instrmt::trace::Site), sites.size(), saved_sites, sites.data());
+      saved_sites += static_cast<std::uint32_t>(sites.size());
+    }
+  }
+
+public:
+  Recorder(const Ring& ring, const std::string& filename)
+    : ring(ring)
+    , file(fopen(filename.c_str(), "wb"))
+  {
+    if (file == nullptr)
+      throw std::runtime_error("unable to open " + filename + " (" + std::strerror(errno) + ")");
+
+    instrmt::trace::FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, instrmt::trace::file_magic, sizeof(header.magic));
+    header.version = instrmt::trace::file_version;
+    header.pid = ring.header->pid;
+    header.clock_offset = ring.header->clock_offset;
+    fwrite(&header, sizeof(header), 1, file);
+  }
+
+  Recorder(const Recorder&) = delete;
+  Recorder& operator=(const Recorder&) = delete;
+
+  ~Recorder() {
+    fclose(file);
+  }
+
+  void write(const std::vector<Event>& events) {
+    save_sites();
+    if (!events.empty())
+      write_block(instrmt::trace::BlockType::events, sizeof(Event), events.size(), 0, events.data());
+    fflush(file);
+  }
+};
+
+bool is_alive(pid_t pid) {
+  return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+template<typename Output>
+void tail(const Ring& ring, Output& output, pid_t pid, std::chrono::milliseconds interval) {
+  Reader reader(ring);
+  std::vector<Event> events;
+
+  bool alive = true;
+  while (alive && !stop_requested) {
+    alive = is_alive(pid);
+
+    events.clear();
+    reader.poll(events);
+    output.write(events);
+
+    if (alive && !stop_requested)
+      std::this_thread::sleep_for(interval);
+  }
+
+  if (reader.lost > 0)
+    fprintf(stderr, "[INSTRMT/TAIL] %llu events lost (the reader was too slow)\n", static_cast<unsigned long long>(reader.lost));
+
+  const std::uint64_t dropped = ring.header->dropped.load(std::memory_order_relaxed);
+  if (dropped > 0)
+    fprintf(stderr, "[INSTRMT/TAIL] %llu events dropped (not enough lanes)\n", static_cast<unsigned long long>(dropped));
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+  std::string output;
+  std::chrono::milliseconds interval{100};
+
+  int opt;
+  while ((opt = getopt(argc, argv, "o:i:h")) != -1) {
+    switch (opt) {
+    case 'o':
+      output = optarg;
+      break;
+    case 'i':
+      interval = std::chrono::milliseconds(std::atoi(optarg));
+      break;
+    case 'h':
+      usage(stdout);
+      return EXIT_SUCCESS;
+    default:
+      usage(stderr);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (optind + 1 != argc) {
+    usage(stderr);
+    return EXIT_FAILURE;
+  }
+
+  const unsigned long pid = std::strtoul(argv[optind], nullptr, 10);
+
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = on_signal;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  try {
+    const Ring ring(pid);
+    if (output.empty()) {
+      Printer printer(ring);
+      tail(ring, printer, static_cast<pid_t>(pid), interval);
+    } else {
+      Recorder recorder(ring, output);
+      tail(ring, recorder, static_cast<pid_t>(pid), interval);
+    }
+  } catch (const std::exception& ex) {
+    fprintf(stderr, "[INSTRMT/TAIL] %s\n", ex.what());
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}